@@ -0,0 +1,90 @@
+#include "sbncafmaker/CAFMaker/AsyncRecordWriter.h"
+
+#include <utility>
+
+namespace caf
+{
+  //......................................................................
+  AsyncRecordWriter::AsyncRecordWriter(WriteFunc write, unsigned max_queue)
+    : fWrite(std::move(write)),
+      fMaxQueue(max_queue > 0 ? max_queue : 1),
+      fBusy(false),
+      fStop(false)
+  {
+    fThread = std::thread(&AsyncRecordWriter::Run, this);
+  }
+
+  //......................................................................
+  AsyncRecordWriter::~AsyncRecordWriter()
+  {
+    {
+      std::lock_guard<std::mutex> lock(fMutex);
+      fStop = true;
+    }
+    fChanged.notify_all();
+    fThread.join();
+  }
+
+  //......................................................................
+  void AsyncRecordWriter::Push(StandardRecord&& rec)
+  {
+    std::unique_lock<std::mutex> lock(fMutex);
+    fChanged.wait(lock, [this]{ return fError || fQueue.size() < fMaxQueue; });
+    RethrowError();
+    fQueue.push_back(std::move(rec));
+    lock.unlock();
+    fChanged.notify_all();
+  }
+
+  //......................................................................
+  void AsyncRecordWriter::Flush()
+  {
+    std::unique_lock<std::mutex> lock(fMutex);
+    fChanged.wait(lock, [this]{ return fError || (fQueue.empty() && !fBusy); });
+    RethrowError();
+  }
+
+  //......................................................................
+  void AsyncRecordWriter::RethrowError()
+  {
+    if(!fError) return;
+    // Report it only once
+    std::exception_ptr err = fError;
+    fError = nullptr;
+    fQueue.clear();
+    std::rethrow_exception(err);
+  }
+
+  //......................................................................
+  void AsyncRecordWriter::Run()
+  {
+    std::unique_lock<std::mutex> lock(fMutex);
+    while(true){
+      fChanged.wait(lock, [this]{ return fStop || (!fError && !fQueue.empty()); });
+      // Once stopped, still drain the queue unless the writer failed
+      if(fError || fQueue.empty()) return;
+
+      StandardRecord rec = std::move(fQueue.front());
+      fQueue.pop_front();
+      fBusy = true;
+      lock.unlock();
+      fChanged.notify_all();
+
+      std::exception_ptr err;
+      try{
+        fWrite(rec);
+      }
+      catch(...){
+        err = std::current_exception();
+      }
+
+      lock.lock();
+      fBusy = false;
+      if(err){
+        fError = err;
+        fQueue.clear();
+      }
+      fChanged.notify_all();
+    }
+  }
+}
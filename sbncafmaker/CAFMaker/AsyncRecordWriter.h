@@ -0,0 +1,68 @@
+//////////////////////////////////////////////////////////////////////
+// \file    AsyncRecordWriter.h
+// \brief   Hands finished StandardRecords to a background thread that
+//          fills the output trees, so that ROOT serialization and
+//          compression overlap with the processing of the next event
+//////////////////////////////////////////////////////////////////////
+
+#ifndef CAF_ASYNCRECORDWRITER_H
+#define CAF_ASYNCRECORDWRITER_H
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace caf
+{
+  /// \brief Bounded queue of records written by one background thread
+  ///
+  /// Records are written one at a time, in the order they were pushed, so
+  /// the output is the same as calling the write function directly. Push()
+  /// blocks while the queue is full. An exception thrown by the write
+  /// function stops the writer, and is rethrown by the next Push() or
+  /// Flush().
+  class AsyncRecordWriter
+  {
+  public:
+    typedef std::function<void(StandardRecord&)> WriteFunc;
+
+    AsyncRecordWriter(WriteFunc write, unsigned max_queue);
+    /// Writes out whatever is still queued. Errors are dropped: call
+    /// Flush() first to see them.
+    ~AsyncRecordWriter();
+
+    AsyncRecordWriter(const AsyncRecordWriter&) = delete;
+    AsyncRecordWriter& operator=(const AsyncRecordWriter&) = delete;
+
+    void Push(StandardRecord&& rec);
+
+    /// \brief Wait until every record pushed so far has been written
+    ///
+    /// Must be called before the output files are touched from any other
+    /// thread.
+    void Flush();
+
+  protected:
+    void Run();
+    void RethrowError(); ///< Call with fMutex held
+
+    WriteFunc fWrite;
+    unsigned fMaxQueue;
+
+    std::mutex fMutex;
+    std::condition_variable fChanged; ///< Signalled on every change of state
+    std::deque<StandardRecord> fQueue;
+    bool fBusy;  ///< The writer thread is writing a record
+    bool fStop;
+    std::exception_ptr fError;
+
+    std::thread fThread;
+  };
+}
+
+#endif
@@ -20,6 +20,20 @@ namespace caf
     using string   = std::string;
     using InputTag = art::InputTag;
 
+    struct BranchSelection
+    {
+      Sequence<string> Include { Name("Include"),
+        Comment("Glob patterns of the dotted branch names to write, eg 'rec.hdr' or 'rec.slc.*'."
+                " A pattern also selects the children of the branches it matches."),
+        std::vector<string>{"*"}
+      };
+
+      Sequence<string> Exclude { Name("Exclude"),
+        Comment("Glob patterns of branches not to write, even if they match Include."),
+        std::vector<string>{}
+      };
+    };
+
     /* Atom<bool> EnableBlindness */
     /* { */
     /*   Name("EnableBlindness"), */
@@ -42,6 +56,21 @@ namespace caf
       Comment("Provide a string to override the automatic filename."), ""
     };
 
+    Atom<std::string> CAFCompression { Name("CAFCompression"),
+      Comment("Compression of the CAF file as 'ALGORITHM:LEVEL', with ALGORITHM one of ZLIB, LZMA, LZ4"
+              " or ZSTD and LEVEL from 1 to 9. Empty for the ROOT default."),
+      ""
+    };
+
+    Atom<std::string> FlatCAFCompression { Name("FlatCAFCompression"),
+      Comment("Compression of the FlatCAF file, in the same format as CAFCompression."),
+      "LZ4:1"
+    };
+
+    Table<BranchSelection> FlatCAFBranchSelection { Name("FlatCAFBranchSelection"),
+      Comment("Which branches of the FlatCAF to create and fill. All of them by default.")
+    };
+
     Atom<std::string> DetectorOverride { Name("DetectorOverride"),
       Comment("Override the automatically detectected detector using 'sbnd' or 'icarus'. This parameter should usually be unset - ''"),
       ""
@@ -56,6 +85,91 @@ namespace caf
 	Comment("Abort if any required product not found, unless label is empty")
     };
 
+    Atom<bool> UseEventAssnIndex {
+      Name("UseEventAssnIndex"),
+      Comment("Look up slice associations through an index of each art::Assns built once per event."
+              " Set to false to construct an art::FindManyP per slice instead (e.g. for validation)."),
+      true
+    };
+
+    Atom<bool> ValidateTruthMatching {
+      Name("ValidateTruthMatching"),
+      Comment("Also run the reference implementation of the track/shower/stub truth matching"
+              " and abort if the two disagree. Slow; for validation only."),
+      false
+    };
+
+    Atom<unsigned> NSliceThreads {
+      Name("NSliceThreads"),
+      Comment("Number of threads used to fill the reco objects of the slices of an event."
+              " Slices are still merged into the record in order. 0 or 1 fills them serially."),
+      1
+    };
+
+    Atom<unsigned> NTrueParticleThreads {
+      Name("NTrueParticleThreads"),
+      Comment("Number of threads used to fill the true G4 particles of an event. Each particle"
+              " is written to its own slot of the particle list. 0 or 1 fills them serially."),
+      1
+    };
+
+    Atom<bool> CreateArtProduct {
+      Name("CreateArtProduct"),
+      Comment("Also put the StandardRecord in the art event. Only useful when an art output"
+              " stream is configured; set to false to save the memory it takes."),
+      true
+    };
+
+    Atom<unsigned> WriterQueueSize {
+      Name("WriterQueueSize"),
+      Comment("Fill the output trees on a background thread, with up to this many finished"
+              " records waiting for it; produce() blocks while the queue is full. Records are"
+              " written in event order. 0 fills them in produce()."),
+      0
+    };
+
+    Atom<unsigned> ROOTIMTThreads {
+      Name("ROOTIMTThreads"),
+      Comment("Enable ROOT implicit multi-threading with this many threads, so that the baskets"
+              " of the output trees are compressed in parallel. 0 leaves it disabled."),
+      0
+    };
+
+    Atom<long long> RecTreeAutoFlush {
+      Name("RecTreeAutoFlush"),
+      Comment("TTree::SetAutoFlush value for the CAF and flat CAF recTree: entries if positive,"
+              " bytes if negative. 0 keeps the ROOT default."),
+      0
+    };
+
+    Atom<int> RecTreeBasketSize {
+      Name("RecTreeBasketSize"),
+      Comment("Basket size in bytes of every branch of the CAF and flat CAF recTree."
+              " 0 keeps the ROOT default."),
+      0
+    };
+
+    Atom<bool> EnablePerfMonitor {
+      Name("EnablePerfMonitor"),
+      Comment("Time the stages of produce() and count the objects processed. The totals are"
+              " printed at the end of the job and saved as a perfTree in each output file."),
+      false
+    };
+
+    Atom<bool> EnableMemoryMonitor {
+      Name("EnableMemoryMonitor"),
+      Comment("Record the RSS change over each stage of produce() and the size of the large"
+              " intermediate objects of each event, and report the largest events at the end of the job."),
+      false
+    };
+
+    Atom<double> MemoryOutlierFactor {
+      Name("MemoryOutlierFactor"),
+      Comment("Events whose value of a monitored quantity exceeds this multiple of its mean are"
+              " reported as outliers by EnableMemoryMonitor."),
+      3.
+    };
+
     Atom<bool> CutClearCosmic {
       Name("CutClearCosmic"),
       Comment("Cut slices which are marked as a 'clear-cosmic' by pandora"),
@@ -41,12 +41,18 @@
 #include "ifdh_art/IFDHService/IFDH_service.h"
 
 // ROOT includes
+#include "Compression.h"
 #include "TFile.h"
 #include "TH1D.h"
 #include "TTree.h"
 #include "TTimeStamp.h"
 #include "TRandomGen.h"
 #include "TObjString.h"
+#include "TROOT.h"
+
+// TBB
+#include "tbb/parallel_for.h"
+#include "tbb/task_arena.h"
 
 // Framework includes
 #include "art/Framework/Core/EDProducer.h"
@@ -71,6 +77,7 @@
 #include "canvas/Persistency/Common/FindOneP.h"
 #include "canvas/Persistency/Common/Ptr.h"
 #include "canvas/Persistency/Common/PtrVector.h"
+#include "canvas/Persistency/Provenance/ProcessHistoryID.h"
 
 #include "cetlib_except/exception.h"
 #include "cetlib_except/demangle.h"
@@ -119,6 +126,11 @@
 
 // // CAFMaker
 #include "sbncafmaker/CAFMaker/AssociationUtil.h"
+#include "sbncafmaker/CAFMaker/AsyncRecordWriter.h"
+#include "sbncafmaker/CAFMaker/EventAssnIndex.h"
+#include "sbncafmaker/CAFMaker/FlatBranchSelection.h"
+#include "sbncafmaker/CAFMaker/MemoryMonitor.h"
+#include "sbncafmaker/CAFMaker/PerfMonitor.h"
 // #include "sbncafmaker/CAFMaker/Blinding.h"
 
 // Metadata
@@ -187,9 +199,26 @@ class CAFMaker : public art::EDProducer {
   TTree* fFlatTree = 0;
 
   flat::Flat<caf::StandardRecord>* fFlatRecord = 0;
+  /// Null if every flat branch is written
+  std::unique_ptr<FlatBranchSelection> fFlatBranchPolicy;
+
+  PerfMonitor fPerf;
+  MemoryMonitor fMemory;
+
+  /// Fills the trees in the background. Null if WriterQueueSize is 0.
+  std::unique_ptr<AsyncRecordWriter> fWriter;
 
   Det_t fDet;  ///< Detector ID in caf namespace typedef
 
+  /// Header fields that are the same for every event of the job (proc,
+  /// cluster) or of the run (det). Each record's header starts as a copy.
+  SRHeader fHeaderTemplate;
+
+  /// Process history that fNGenEvt was counted from
+  art::ProcessHistoryID fNGenEvtHistoryID;
+  /// Number of events generated in the gen stage, from source.maxEvents
+  unsigned fNGenEvt = 0;
+
   // volumes
   std::vector<std::vector<geo::BoxBoundedGeo>> fTPCVolumes;
   std::vector<geo::BoxBoundedGeo> fActiveVolumes;
@@ -212,6 +241,17 @@ class CAFMaker : public art::EDProducer {
   void AddHistogramsToFile(TFile* outfile) const;
 
   void InitializeOutfiles();
+  /// \brief ROOT compression settings from an "ALGORITHM:LEVEL" string
+  ///
+  /// eg "LZ4:1" or "ZSTD:5". An empty string gives the ROOT default.
+  int ParseCompression(const std::string& param, const std::string& setting) const;
+  /// Apply the AutoFlush and BasketSize parameters to \a tree
+  void ConfigureRecTree(TTree* tree) const;
+
+  /// Fill the CAF and flat CAF trees with \a rec
+  void WriteRecord(StandardRecord& rec);
+  /// Wait for the background writer, if any, to be done with the files
+  void FlushWriter();
 
   void InitVolumes(); ///< Initialize volumes from Gemotry service
 
@@ -232,6 +272,22 @@ class CAFMaker : public art::EDProducer {
   art::FindOneP<T> FindOnePStrict(const U& from, const art::Event& evt,
 				  const art::InputTag& label) const;
 
+  /// Equivalent of FindManyPStrict, but served from the per-event index
+  /// in \a cache unless UseEventAssnIndex is false.
+  template <class T, class U>
+  AssnLookup<T> LookupAssnsStrict(const std::vector<art::Ptr<U>>& from,
+                                  const art::Event& evt,
+                                  const art::InputTag& tag,
+                                  EventAssnCache& cache) const;
+
+  /// Equivalent of FindOnePStrict, but served from the per-event index
+  /// in \a cache unless UseEventAssnIndex is false.
+  template <class T, class U>
+  AssnLookup<T> LookupOneAssnStrict(const std::vector<art::Ptr<U>>& from,
+                                    const art::Event& evt,
+                                    const art::InputTag& tag,
+                                    EventAssnCache& cache) const;
+
 
   /// \brief Retrieve an object from an association, with error handling
   ///
@@ -267,6 +323,68 @@ class CAFMaker : public art::EDProducer {
   bool GetPsetParameter(const fhicl::ParameterSet& pset,
                         const std::vector<std::string>& name, T& ret) const;
 
+  /// Everything looked up from the event for one slice. It is gathered
+  /// serially, so that the slices can then be filled concurrently without
+  /// touching the event.
+  struct SliceInputs {
+    art::Ptr<recob::Slice> slice;
+    unsigned producer;
+
+    std::vector<art::Ptr<recob::PFParticle>> fmPFPart;
+    std::vector<art::Ptr<recob::Hit>> slcHits;
+    const sbn::CRUMBSResult *slcCRUMBS = nullptr;
+
+    // primary particle, its meta-data, flash match and vertex
+    const recob::PFParticle *primary = nullptr;
+    const larpandoraobj::PFParticleMetadata *primary_meta = nullptr;
+    const sbn::SimpleFlashMatch *fmatch = nullptr;
+    const recob::Vertex *vertex = nullptr;
+
+    AssnLookup<larpandoraobj::PFParticleMetadata> fmPFPMeta;
+    AssnLookup<recob::Shower> fmShower;
+    AssnLookup<float> fmShowerCosmicDist;
+    AssnLookup<float> fmShowerResiduals;
+    AssnLookup<sbn::ShowerTrackFit> fmShowerTrackFit;
+    AssnLookup<sbn::ShowerDensityFit> fmShowerDensityFit;
+    AssnLookup<recob::Track> fmTrack;
+    std::vector<art::Ptr<sbn::Stub>> fmStubs;
+    AssnLookup<recob::PFParticle> fmStubPFPs;
+    AssnLookup<recob::Hit> fmStubHits;
+    AssnLookup<anab::Calorimetry> fmCalo;
+    AssnLookup<anab::ParticleID> fmChi2PID;
+    AssnLookup<sbn::ScatterClosestApproach> fmScatterClosestApproach;
+    AssnLookup<sbn::StoppingChi2Fit> fmStoppingChi2Fit;
+    AssnLookup<sbn::MVAPID> fmTrackDazzle;
+    AssnLookup<sbn::MVAPID> fmShowerRazzle;
+    AssnLookup<recob::Hit> fmTrackHit;
+    AssnLookup<recob::Hit> fmShowerHit;
+    AssnLookup<anab::T0> fmCRTHitMatch;
+    AssnLookup<anab::T0> fmCRTTrackMatch;
+    std::vector<AssnLookup<recob::MCSFitResult>> fmMCSs;
+    std::vector<AssnLookup<sbn::RangeP>> fmRanges;
+  };
+
+  /// Look up all of the associations of \a slice
+  SliceInputs GatherSliceInputs(const art::Event& evt,
+                                const art::Ptr<recob::Slice>& slice,
+                                const std::string& slice_tag_suff,
+                                unsigned producer,
+                                EventAssnCache& cache) const;
+
+  /// \brief Fill the stubs, tracks and showers of one slice into \a recslc
+  ///
+  /// Reads only \a in and the per-event truth tables, so that several slices
+  /// may be filled at once. The hits of the slice objects must already be in
+  /// \a hit_truth.
+  void FillSliceReco(const SliceInputs& in,
+                     bool isRealData,
+                     const CAFRecoUtils::HitTruthCache& hit_truth,
+                     const caf::TrackIDMap<caf::HitsEnergy>& id_to_hit_energy_map,
+                     const std::vector<caf::SRTrueParticle>& true_particles,
+                     const geo::GeometryCore* geometry,
+                     const detinfo::DetectorPropertiesData& dprop,
+                     caf::SRSlice& recslc) const;
+
   static bool EssentiallyEqual(double a, double b, double precision = 0.0001) {
     return a <= (b + precision) && a >= (b - precision);
   }
@@ -285,7 +403,8 @@ class CAFMaker : public art::EDProducer {
 
   CAFMaker::CAFMaker(const Parameters& params)
   : art::EDProducer{params},
-    fParams(params()), fFile(0)
+    fParams(params()), fFile(0), fPerf(fParams.EnablePerfMonitor()),
+    fMemory(fParams.EnableMemoryMonitor(), fParams.MemoryOutlierFactor())
   {
   // Note: we will define isRealData on a per event basis in produce function [using event.isRealData()], at least for now.
 
@@ -295,7 +414,18 @@ class CAFMaker : public art::EDProducer {
   // Normally CAFMaker is run wit no output ART stream, so these go
   // nowhere, but can be occasionally useful for filtering in ART
 
-  produces<std::vector<caf::StandardRecord>>();
+  if (fParams.CreateArtProduct()) {
+    produces<std::vector<caf::StandardRecord>>();
+  }
+  else {
+    // An output module would silently write nothing from this module
+    const fhicl::ParameterSet& process_pset = art::ServiceHandle<art::TriggerNamesService const>()->getProcessPSet();
+    const fhicl::ParameterSet outputs = process_pset.get<fhicl::ParameterSet>("outputs", fhicl::ParameterSet());
+    if (!outputs.get_names().empty()) {
+      mf::LogWarning("CAFMaker") << "CreateArtProduct is false, but this job has output modules."
+                                 << " They will not receive the StandardRecord product.";
+    }
+  }
   //produces<art::Assns<caf::StandardRecord, recob::Slice>>();
 
   // setup volume definitions
@@ -304,6 +434,19 @@ class CAFMaker : public art::EDProducer {
   // setup random number generator
   fFakeRecoTRandom = new TRandomMT64(art::ServiceHandle<rndm::NuRandomService>()->getSeed());
 
+  if(fParams.ROOTIMTThreads() > 0){
+    // Lets TTree::Fill compress the baskets of different branches in
+    // parallel when it flushes
+    ROOT::EnableImplicitMT(fParams.ROOTIMTThreads());
+  }
+
+  if(fParams.WriterQueueSize() > 0){
+    // ROOT is now used from two threads
+    ROOT::EnableThreadSafety();
+    fWriter = std::make_unique<AsyncRecordWriter>([this](StandardRecord& rec){ WriteRecord(rec); },
+                                                  fParams.WriterQueueSize());
+  }
+
 }
 
 void CAFMaker::InitVolumes() {
@@ -339,6 +482,9 @@ void CAFMaker::InitVolumes() {
 //......................................................................
 CAFMaker::~CAFMaker()
 {
+  // The writer thread uses the trees
+  fWriter.reset();
+
   delete fRecTree;
   delete fFile;
 
@@ -388,6 +534,24 @@ void CAFMaker::respondToOpenInputFile(const art::FileBlock& fb) {
 //......................................................................
 void CAFMaker::beginJob()
 {
+  fHeaderTemplate = SRHeader();
+
+  // Get the Process and Cluser number
+  const char *process_str = std::getenv("PROCESS");
+  if (process_str) {
+    try {
+      fHeaderTemplate.proc = std::stoi(process_str);
+    }
+    catch (...) {}
+  }
+
+  const char *cluster_str = std::getenv("CLUSTER");
+  if (cluster_str) {
+    try {
+      fHeaderTemplate.cluster = std::stoi(cluster_str);
+    }
+    catch (...) {}
+  }
 }
 
 //......................................................................
@@ -458,6 +622,8 @@ void CAFMaker::beginRun(art::Run& run) {
     fDet = override;
   }
 
+  fHeaderTemplate.det = fDet;
+
 
   if(fParams.SystWeightLabels().empty()) return; // no need for globalTree
 
@@ -497,6 +663,7 @@ void CAFMaker::beginRun(art::Run& run) {
     } // end for pset
   } // end for label
 
+  FlushWriter();
   if(fFile) AddGlobalTreeToFile(fFile, global);
   if(fFlatFile) AddGlobalTreeToFile(fFlatFile, global);
 }
@@ -625,13 +792,15 @@ void CAFMaker::InitializeOutfiles()
   if(fParams.CreateCAF()){
     mf::LogInfo("CAFMaker") << "Output filename is " << fCafFilename;
 
-    fFile = new TFile(fCafFilename.c_str(), "RECREATE");
+    fFile = new TFile(fCafFilename.c_str(), "RECREATE", "",
+                      ParseCompression("CAFCompression", fParams.CAFCompression()));
 
     fRecTree = new TTree("recTree", "records");
 
     // Tell the tree it's expecting StandardRecord objects
     StandardRecord* rec = 0;
     fRecTree->Branch("rec", "caf::StandardRecord", &rec);
+    ConfigureRecTree(fRecTree);
 
     AddEnvToFile(fFile);
   }
@@ -639,14 +808,20 @@ void CAFMaker::InitializeOutfiles()
   if(fParams.CreateFlatCAF()){
     mf::LogInfo("CAFMaker") << "Output flat filename is " << fFlatCafFilename;
 
-    // LZ4 is the fastest format to decompress. I get 3x faster loading with
-    // this compared to the default, and the files are only slightly larger.
+    // LZ4 (the default) is the fastest format to decompress. I get 3x
+    // faster loading with this compared to the ROOT default, and the files
+    // are only slightly larger.
     fFlatFile = new TFile(fFlatCafFilename.c_str(), "RECREATE", "",
-                          ROOT::CompressionSettings(ROOT::kLZ4, 1));
+                          ParseCompression("FlatCAFCompression", fParams.FlatCAFCompression()));
 
     fFlatTree = new TTree("recTree", "recTree");
 
-    fFlatRecord = new flat::Flat<caf::StandardRecord>(fFlatTree, "rec", "", 0);
+    fFlatBranchPolicy = std::make_unique<FlatBranchSelection>(fParams.FlatCAFBranchSelection().Include(),
+                                                              fParams.FlatCAFBranchSelection().Exclude());
+    if(fFlatBranchPolicy->SelectsAll()) fFlatBranchPolicy.reset();
+
+    fFlatRecord = new flat::Flat<caf::StandardRecord>(fFlatTree, "rec", "", fFlatBranchPolicy.get());
+    ConfigureRecTree(fFlatTree);
 
     AddEnvToFile(fFlatFile);
   }
@@ -662,6 +837,85 @@ void CAFMaker::InitializeOutfiles()
   // fBatch = -5;
 }
 
+//......................................................................
+int CAFMaker::ParseCompression(const std::string& param, const std::string& setting) const
+{
+  if(setting.empty()) return ROOT::RCompressionSetting::EDefaults::kUseCompiledDefault;
+
+  const size_t colon = setting.find(':');
+  const std::string algname = setting.substr(0, colon);
+
+  ROOT::RCompressionSetting::EAlgorithm::EValues alg;
+  if(algname == "ZLIB")      alg = ROOT::RCompressionSetting::EAlgorithm::kZLIB;
+  else if(algname == "LZMA") alg = ROOT::RCompressionSetting::EAlgorithm::kLZMA;
+  else if(algname == "LZ4")  alg = ROOT::RCompressionSetting::EAlgorithm::kLZ4;
+  else if(algname == "ZSTD") alg = ROOT::RCompressionSetting::EAlgorithm::kZSTD;
+  else{
+    std::cout << "CAFMaker: unrecognized compression algorithm in " << param << ": '" << setting
+              << "'. Expected one of ZLIB, LZMA, LZ4 or ZSTD." << std::endl;
+    abort();
+  }
+
+  int level = -1;
+  if(colon != std::string::npos){
+    try{
+      size_t used = 0;
+      level = std::stoi(setting.substr(colon+1), &used);
+      if(used != setting.size()-colon-1) level = -1;
+    }
+    catch(...){}
+  }
+  if(level < 1 || level > 9){
+    std::cout << "CAFMaker: " << param << " must be of the form ALGORITHM:LEVEL, with a level from 1 to 9."
+              << " Got '" << setting << "'" << std::endl;
+    abort();
+  }
+
+  return ROOT::CompressionSettings(alg, level);
+}
+
+//......................................................................
+void CAFMaker::ConfigureRecTree(TTree* tree) const
+{
+  // Zero keeps the ROOT defaults. The basket size has to be set after the
+  // branches are made.
+  if(fParams.RecTreeAutoFlush() != 0) tree->SetAutoFlush(fParams.RecTreeAutoFlush());
+  if(fParams.RecTreeBasketSize() > 0) tree->SetBasketSize("*", fParams.RecTreeBasketSize());
+}
+
+//......................................................................
+void CAFMaker::WriteRecord(StandardRecord& rec)
+{
+  PerfMonitor::Scope scope(fPerf, PerfMonitor::kWrite);
+
+  // This may run on the writer thread, so the event is taken from the record
+  MemoryMonitor::EventID id;
+  id.run = rec.hdr.run;
+  id.subrun = rec.hdr.subrun;
+  id.evt = rec.hdr.evt;
+
+  if(fRecTree){
+    // Save the standard-record
+    StandardRecord* prec = &rec;
+    fRecTree->SetBranchAddress("rec", &prec);
+    const int nbytes = fRecTree->Fill();
+    fMemory.Add("record_bytes", id, nbytes);
+  }
+
+  if(fFlatTree){
+    fFlatRecord->Clear();
+    fFlatRecord->Fill(rec);
+    const int nbytes = fFlatTree->Fill();
+    fMemory.Add("flat_record_bytes", id, nbytes);
+  }
+}
+
+//......................................................................
+void CAFMaker::FlushWriter()
+{
+  if(fWriter) fWriter->Flush();
+}
+
 //......................................................................
 template <class T, class U>
 art::FindManyP<T> CAFMaker::FindManyPStrict(const U& from,
@@ -719,6 +973,43 @@ art::FindOneP<T> CAFMaker::FindOnePStrict(const U& from,
   return ret;
 }
 
+//......................................................................
+template <class T, class U>
+AssnLookup<T> CAFMaker::LookupAssnsStrict(const std::vector<art::Ptr<U>>& from,
+                                          const art::Event& evt,
+                                          const art::InputTag& tag,
+                                          EventAssnCache& cache) const {
+  if (!fParams.UseEventAssnIndex()) {
+    return AssnLookup<T>(FindManyPStrict<T>(from, evt, tag));
+  }
+
+  const EventAssnIndex<U, T>& index = cache.Get<U, T>(tag);
+
+  if (!tag.label().empty() && !index.isValid() && fParams.StrictMode()) {
+    std::cout << "CAFMaker: No Assn from '"
+              << cet::demangle_symbol(typeid(from).name()) << "' to '"
+              << cet::demangle_symbol(typeid(T).name())
+              << "' found under label '" << tag << "'. "
+              << "Set 'StrictMode: false' to continue anyway." << std::endl;
+    abort();
+  }
+
+  return index.Lookup(from);
+}
+
+//......................................................................
+template <class T, class U>
+AssnLookup<T> CAFMaker::LookupOneAssnStrict(const std::vector<art::Ptr<U>>& from,
+                                            const art::Event& evt,
+                                            const art::InputTag& tag,
+                                            EventAssnCache& cache) const {
+  if (!fParams.UseEventAssnIndex()) {
+    return AssnLookup<T>(FindOnePStrict<T>(from, evt, tag));
+  }
+
+  return LookupAssnsStrict<T>(from, evt, tag, cache);
+}
+
 //......................................................................
 template <class T>
 bool CAFMaker::GetAssociatedProduct(const art::FindManyP<T>& fm, int idx,
@@ -777,9 +1068,385 @@ bool CAFMaker::GetPsetParameter(const fhicl::ParameterSet& pset,
   return true;
 }
 
+//......................................................................
+CAFMaker::SliceInputs CAFMaker::GatherSliceInputs(const art::Event& evt,
+                                                  const art::Ptr<recob::Slice>& slice,
+                                                  const std::string& slice_tag_suff,
+                                                  unsigned producer,
+                                                  EventAssnCache& assn_cache) const
+{
+  SliceInputs in;
+  in.slice = slice;
+  in.producer = producer;
+
+  // Get tracks & showers here
+  std::vector<art::Ptr<recob::Slice>> sliceList {slice};
+  AssnLookup<recob::PFParticle> findManyPFParts =
+     LookupAssnsStrict<recob::PFParticle>(sliceList, evt,  fParams.PFParticleLabel() + slice_tag_suff, assn_cache);
+
+  if (findManyPFParts.isValid()) {
+    in.fmPFPart = findManyPFParts.at(0);
+  }
+  const std::vector<art::Ptr<recob::PFParticle>>& fmPFPart = in.fmPFPart;
+
+  AssnLookup<recob::Hit> fmSlcHits =
+    LookupAssnsStrict<recob::Hit>(sliceList, evt,
+        fParams.PFParticleLabel() + slice_tag_suff, assn_cache);
+  if (fmSlcHits.isValid()) {
+    in.slcHits = fmSlcHits.at(0);
+  }
+
+  AssnLookup<sbn::CRUMBSResult> foSlcCRUMBS =
+    LookupOneAssnStrict<sbn::CRUMBSResult>(sliceList, evt,
+        fParams.CRUMBSLabel() + slice_tag_suff, assn_cache);
+  if (foSlcCRUMBS.isValid() && !foSlcCRUMBS.at(0).empty()) {
+    in.slcCRUMBS = foSlcCRUMBS.at(0).front().get();
+  }
+
+  AssnLookup<sbn::SimpleFlashMatch> fm_sFM =
+    LookupAssnsStrict<sbn::SimpleFlashMatch>(fmPFPart, evt,
+                                           fParams.FlashMatchLabel() + slice_tag_suff, assn_cache);
+
+  in.fmPFPMeta =
+    LookupAssnsStrict<larpandoraobj::PFParticleMetadata>(fmPFPart, evt,
+             fParams.PFParticleLabel() + slice_tag_suff, assn_cache);
+
+  in.fmShower =
+    LookupAssnsStrict<recob::Shower>(fmPFPart, evt, fParams.RecoShowerLabel() + slice_tag_suff, assn_cache);
+
+  // make Ptr's to showers for shower -> other object associations
+  std::vector<art::Ptr<recob::Shower>> slcShowers;
+  if (in.fmShower.isValid()) {
+    for (unsigned i = 0; i < in.fmShower.size(); i++) {
+      const std::vector<art::Ptr<recob::Shower>> &thisShowers = in.fmShower.at(i);
+      if (thisShowers.size() == 0) {
+        slcShowers.emplace_back(); // nullptr
+      }
+      else if (thisShowers.size() == 1) {
+        slcShowers.push_back(in.fmShower.at(i).at(0));
+      }
+      else assert(false); // bad
+    }
+  }
+
+  in.fmShowerCosmicDist =
+    LookupAssnsStrict<float>(slcShowers, evt, fParams.ShowerCosmicDistLabel() + slice_tag_suff, assn_cache);
+
+  in.fmShowerResiduals =
+    LookupAssnsStrict<float>(slcShowers, evt, fParams.RecoShowerSelectionLabel() + slice_tag_suff, assn_cache);
+
+  in.fmShowerTrackFit =
+    LookupAssnsStrict<sbn::ShowerTrackFit>(slcShowers, evt, fParams.RecoShowerSelectionLabel() + slice_tag_suff, assn_cache);
+
+  in.fmShowerDensityFit =
+    LookupAssnsStrict<sbn::ShowerDensityFit>(slcShowers, evt, fParams.RecoShowerSelectionLabel() + slice_tag_suff, assn_cache);
+
+  in.fmTrack =
+    LookupAssnsStrict<recob::Track>(fmPFPart, evt,
+          fParams.RecoTrackLabel() + slice_tag_suff, assn_cache);
+
+  // make Ptr's to tracks for track -> other object associations
+  std::vector<art::Ptr<recob::Track>> slcTracks;
+  if (in.fmTrack.isValid()) {
+    for (unsigned i = 0; i < in.fmTrack.size(); i++) {
+      const std::vector<art::Ptr<recob::Track>> &thisTracks = in.fmTrack.at(i);
+      if (thisTracks.size() == 0) {
+        slcTracks.emplace_back(); // nullptr
+      }
+      else if (thisTracks.size() == 1) {
+        slcTracks.push_back(in.fmTrack.at(i).at(0));
+      }
+      else assert(false); // bad
+    }
+  }
+
+  // Get the stubs!
+  AssnLookup<sbn::Stub> fmSlcStubs =
+    LookupAssnsStrict<sbn::Stub>(sliceList, evt,
+        fParams.StubLabel() + slice_tag_suff, assn_cache);
+
+  if (fmSlcStubs.isValid()) {
+    in.fmStubs = fmSlcStubs.at(0);
+  } 
+
+  // Lookup stubs to overlaid PFP
+  in.fmStubPFPs =
+    LookupAssnsStrict<recob::PFParticle>(in.fmStubs, evt,
+        fParams.StubLabel() + slice_tag_suff, assn_cache);
+  // and get the stub hits for truth matching
+  in.fmStubHits =
+    LookupAssnsStrict<recob::Hit>(in.fmStubs, evt,
+        fParams.StubLabel() + slice_tag_suff, assn_cache);
+
+  in.fmCalo =
+    LookupAssnsStrict<anab::Calorimetry>(slcTracks, evt,
+         fParams.TrackCaloLabel() + slice_tag_suff, assn_cache);
+
+  in.fmChi2PID =
+    LookupAssnsStrict<anab::ParticleID>(slcTracks, evt,
+        fParams.TrackChi2PidLabel() + slice_tag_suff, assn_cache);
+
+  in.fmScatterClosestApproach =
+    LookupAssnsStrict<sbn::ScatterClosestApproach>(slcTracks, evt,
+        fParams.TrackScatterClosestApproachLabel() + slice_tag_suff, assn_cache);
+
+  in.fmStoppingChi2Fit =
+    LookupAssnsStrict<sbn::StoppingChi2Fit>(slcTracks, evt,
+        fParams.TrackStoppingChi2FitLabel() + slice_tag_suff, assn_cache);
+
+  in.fmTrackDazzle =
+    LookupAssnsStrict<sbn::MVAPID>(slcTracks, evt,
+        fParams.TrackDazzleLabel() + slice_tag_suff, assn_cache);
+
+  in.fmShowerRazzle =
+    LookupAssnsStrict<sbn::MVAPID>(slcShowers, evt,
+        fParams.ShowerRazzleLabel() + slice_tag_suff, assn_cache);
+
+  AssnLookup<recob::Vertex> fmVertex =
+    LookupAssnsStrict<recob::Vertex>(fmPFPart, evt,
+           fParams.PFParticleLabel() + slice_tag_suff, assn_cache);
+
+  in.fmTrackHit =
+    LookupAssnsStrict<recob::Hit>(slcTracks, evt,
+        fParams.RecoTrackLabel() + slice_tag_suff, assn_cache);
+
+  in.fmShowerHit =
+    LookupAssnsStrict<recob::Hit>(slcShowers, evt,
+        fParams.RecoShowerLabel() + slice_tag_suff, assn_cache);
+
+  // TODO: also save the sbn::crt::CRTHit in the matching so that CAFMaker has access to it
+  in.fmCRTHitMatch =
+    LookupAssnsStrict<anab::T0>(slcTracks, evt,
+             fParams.CRTHitMatchLabel() + slice_tag_suff, assn_cache);
+
+  // TODO: also save the sbn::crt::CRTTrack in the matching so that CAFMaker has access to it
+  in.fmCRTTrackMatch =
+    LookupAssnsStrict<anab::T0>(slcTracks, evt,
+             fParams.CRTTrackMatchLabel() + slice_tag_suff, assn_cache);
+
+  static const std::vector<std::string> PIDnames {"muon", "pion", "kaon", "proton"};
+  for (std::string pid: PIDnames) {
+    art::InputTag tag(fParams.TrackMCSLabel() + slice_tag_suff, pid);
+    in.fmMCSs.push_back(LookupAssnsStrict<recob::MCSFitResult>(slcTracks, evt, tag, assn_cache));
+  }
+
+  static const std::vector<std::string> rangePIDnames {"muon", "pion", "proton"};
+  for (std::string pid: rangePIDnames) {
+    art::InputTag tag(fParams.TrackRangeLabel() + slice_tag_suff, pid);
+    in.fmRanges.push_back(LookupAssnsStrict<sbn::RangeP>(slcTracks, evt, tag, assn_cache));
+  }
+
+  // get the primary particle
+  size_t iPart;
+  for (iPart = 0; iPart < fmPFPart.size(); ++iPart ) {
+    const recob::PFParticle &thisParticle = *fmPFPart[iPart];
+    if (thisParticle.IsPrimary()) break;
+  }
+  // primary particle and meta-data
+  in.primary = (iPart == fmPFPart.size()) ? NULL : fmPFPart[iPart].get();
+  in.primary_meta = (iPart == fmPFPart.size()) ? NULL : in.fmPFPMeta.at(iPart).at(0).get();
+  // get the flash match
+  if (fm_sFM.isValid() && in.primary != NULL) {
+    std::vector<art::Ptr<sbn::SimpleFlashMatch>> fmatches = fm_sFM.at(iPart);
+    if (fmatches.size() != 0) {
+      assert(fmatches.size() == 1);
+      in.fmatch = fmatches[0].get();
+    }
+  }
+  // get the primary vertex
+  in.vertex = (iPart == fmPFPart.size() || !fmVertex.at(iPart).size()) ? NULL : fmVertex.at(iPart).at(0).get();
+
+  return in;
+}
+
+//......................................................................
+void CAFMaker::FillSliceReco(const SliceInputs& in,
+                             bool isRealData,
+                             const CAFRecoUtils::HitTruthCache& hit_truth,
+                             const caf::TrackIDMap<caf::HitsEnergy>& id_to_hit_energy_map,
+                             const std::vector<caf::SRTrueParticle>& true_particles,
+                             const geo::GeometryCore* geometry,
+                             const detinfo::DetectorPropertiesData& dprop,
+                             caf::SRSlice& recslc) const
+{
+  const std::vector<art::Ptr<recob::PFParticle>>& fmPFPart = in.fmPFPart;
+  const unsigned producer = in.producer;
+  const recob::PFParticle *primary = in.primary;
+  const recob::Vertex *vertex = in.vertex;
+
+  // Whether Pandora thinks this slice is a neutrino
+  //
+  // This requirement is used to determine whether to save additional
+  // per-hit information about the slice.
+  bool NeutrinoSlice = !recslc.is_clear_cosmic;
+
+  //#######################################################
+  // Add detector dependent slice info.
+  //#######################################################
+  // if (fDet == kSBND) {
+  //   rec.sel.contain.nplanestofront = rec.slc.firstplane - (plnfirst - 1);
+  //   rec.sel.contain.nplanestoback = (plnlast) - 1 - rec.slc.lastplane;
+  // }
+
+  //#######################################################
+  // Add stub reconstructed objects.
+  //#######################################################
+  for (size_t iStub = 0; iStub < in.fmStubs.size(); iStub++) {
+    const sbn::Stub &thisStub = *in.fmStubs[iStub];
+
+    art::Ptr<recob::PFParticle> thisStubPFP;
+    if (!in.fmStubPFPs.at(iStub).empty()) thisStubPFP = in.fmStubPFPs.at(iStub).at(0);
+
+    recslc.reco.stub.emplace_back();
+    FillStubVars(thisStub, thisStubPFP, recslc.reco.stub.back());
+    if ( !isRealData ) {
+      FillStubTruth(in.fmStubHits.at(iStub), id_to_hit_energy_map, true_particles, hit_truth, recslc.reco.stub.back(),
+        false, fParams.ValidateTruthMatching());
+    }
+    recslc.reco.nstub = recslc.reco.stub.size();
+  }
+
+  //#######################################################
+  // Add track/shower reconstructed objects.
+  //#######################################################
+  // Reco objects have assns to the slice PFParticles
+  // This depends on the findMany object created above.
+  for ( size_t iPart = 0; iPart < fmPFPart.size(); ++iPart ) {
+    const recob::PFParticle &thisParticle = *fmPFPart[iPart];
+
+    std::vector<art::Ptr<recob::Track>> thisTrack;
+    if (in.fmTrack.isValid()) {
+      thisTrack = in.fmTrack.at(iPart);
+    }
+    std::vector<art::Ptr<recob::Shower>> thisShower;
+    if (in.fmShower.isValid()) {
+      thisShower = in.fmShower.at(iPart);
+    }
+
+    if (!thisTrack.empty())  { // it's a track!
+      assert(thisTrack.size() == 1);
+      assert(thisShower.size() == 0);
+      recslc.reco.trk.push_back(SRTrack());
+      SRTrack& srtrack = recslc.reco.trk.back();
+
+      // collect all the stuff
+      std::array<std::vector<art::Ptr<recob::MCSFitResult>>, 4> trajectoryMCS;
+      for (unsigned index = 0; index < 4; index++) {
+        if (in.fmMCSs[index].isValid()) {
+          trajectoryMCS[index] = in.fmMCSs[index].at(iPart);
+        }
+        else {
+          trajectoryMCS[index] = std::vector<art::Ptr<recob::MCSFitResult>>();
+        }
+      }
+
+      std::array<std::vector<art::Ptr<sbn::RangeP>>, 3> rangePs;
+      for (unsigned index = 0; index < 3; index++) {
+        if (in.fmRanges[index].isValid()) {
+          rangePs[index] = in.fmRanges[index].at(iPart);
+        }
+        else {
+          rangePs[index] = std::vector<art::Ptr<sbn::RangeP>>();
+        }
+      }
+
+
+      // fill all the stuff
+      FillTrackVars(*thisTrack[0], producer, srtrack);
+      FillTrackMCS(*thisTrack[0], trajectoryMCS, srtrack);
+      FillTrackRangeP(*thisTrack[0], rangePs, srtrack);
+
+      const larpandoraobj::PFParticleMetadata *pfpMeta = (in.fmPFPMeta.at(iPart).empty()) ? NULL : in.fmPFPMeta.at(iPart).at(0).get();
+      FillPFPVars(thisParticle, primary, pfpMeta, srtrack.pfp);
+
+      if (in.fmChi2PID.isValid()) {
+         FillTrackChi2PID(in.fmChi2PID.at(iPart), geometry, srtrack);
+      }
+      if (in.fmScatterClosestApproach.isValid() && in.fmScatterClosestApproach.at(iPart).size()==1) {
+         FillTrackScatterClosestApproach(in.fmScatterClosestApproach.at(iPart).front(), srtrack);
+      }
+      if (in.fmStoppingChi2Fit.isValid() && in.fmStoppingChi2Fit.at(iPart).size()==1) {
+         FillTrackStoppingChi2Fit(in.fmStoppingChi2Fit.at(iPart).front(), srtrack);
+      }
+      if (in.fmTrackDazzle.isValid() && in.fmTrackDazzle.at(iPart).size()==1) {
+         FillTrackDazzle(in.fmTrackDazzle.at(iPart).front(), srtrack);
+      }
+      if (in.fmCalo.isValid()) {
+        FillTrackCalo(in.fmCalo.at(iPart), in.fmTrackHit.at(iPart),
+            (fParams.FillHitsNeutrinoSlices() && NeutrinoSlice) || fParams.FillHitsAllSlices(), 
+            fParams.TrackHitFillRRStartCut(), fParams.TrackHitFillRREndCut(),
+            geometry, dprop, srtrack);
+      }
+      if (in.fmTrackHit.isValid()) {
+        if ( !isRealData ) {
+          FillTrackTruth(in.fmTrackHit.at(iPart), id_to_hit_energy_map, true_particles, hit_truth, srtrack,
+            false, fParams.ValidateTruthMatching());
+        }
+      }
+      // NOTE: SEE TODO's AT fmCRTHitMatch and fmCRTTrackMatch
+      if (in.fmCRTHitMatch.isValid()) {
+        FillTrackCRTHit(in.fmCRTHitMatch.at(iPart), srtrack);
+      }
+      if (in.fmCRTTrackMatch.isValid()) {
+        FillTrackCRTTrack(in.fmCRTTrackMatch.at(iPart), srtrack);
+      }
+      recslc.reco.ntrk = recslc.reco.trk.size();
+    } // thisTrack exists
+
+    else if (!thisShower.empty()) { // it's a shower!
+      assert(thisTrack.size() == 0);
+      assert(thisShower.size() == 1);
+      recslc.reco.shw.push_back(SRShower());
+      SRShower& srshower = recslc.reco.shw.back();
+      FillShowerVars(*thisShower[0], vertex, in.fmShowerHit.at(iPart), geometry, producer, srshower);
+
+      const larpandoraobj::PFParticleMetadata *pfpMeta = (iPart == fmPFPart.size()) ? NULL : in.fmPFPMeta.at(iPart).at(0).get();
+      FillPFPVars(thisParticle, primary, pfpMeta, srshower.pfp);
+
+      // We may have many residuals per shower depending on how many showers ar in the slice
+
+      if (in.fmShowerRazzle.isValid() && in.fmShowerRazzle.at(iPart).size()==1) {
+         FillShowerRazzle(in.fmShowerRazzle.at(iPart).front(), srshower);
+      }
+      if (in.fmShowerCosmicDist.isValid() && in.fmShowerCosmicDist.at(iPart).size() != 0) {
+        FillShowerCosmicDist(in.fmShowerCosmicDist.at(iPart), srshower);
+      }
+      if (in.fmShowerResiduals.isValid() && in.fmShowerResiduals.at(iPart).size() != 0) {
+        FillShowerResiduals(in.fmShowerResiduals.at(iPart), srshower);
+      }
+      if (in.fmShowerTrackFit.isValid() && in.fmShowerTrackFit.at(iPart).size()  == 1) {
+        FillShowerTrackFit(*in.fmShowerTrackFit.at(iPart).front(), srshower);
+      }
+      if (in.fmShowerDensityFit.isValid() && in.fmShowerDensityFit.at(iPart).size() == 1) {
+        FillShowerDensityFit(*in.fmShowerDensityFit.at(iPart).front(), srshower);
+      }
+      if (in.fmShowerHit.isValid()) {
+        if ( !isRealData ) {
+          FillShowerTruth(in.fmShowerHit.at(iPart), id_to_hit_energy_map, true_particles, hit_truth, srshower,
+            false, fParams.ValidateTruthMatching());
+        }
+      }
+      recslc.reco.nshw = recslc.reco.shw.size();
+
+    } // thisShower exists
+
+    else {}
+
+  }// end for pfparts
+}
+
 //......................................................................
 void CAFMaker::produce(art::Event& evt) noexcept {
 
+  PerfMonitor::Scope produce_scope(fPerf, PerfMonitor::kProduce);
+  fPerf.Count(PerfMonitor::kEvents);
+
+  MemoryMonitor::EventID event_id;
+  event_id.run = evt.run();
+  event_id.subrun = evt.subRun();
+  event_id.evt = evt.event();
+  fMemory.BeginEvent(event_id);
+
   // is this event real data?
   bool isRealData = evt.isRealData();
 
@@ -887,16 +1554,35 @@ void CAFMaker::produce(art::Event& evt) noexcept {
   }
 
   // Prep truth-to-reco-matching info
-  std::map<int, std::vector<std::pair<geo::WireID, const sim::IDE*>>> id_to_ide_map;
-  std::map<int, std::vector<art::Ptr<recob::Hit>>> id_to_truehit_map;
-  std::map<int, caf::HitsEnergy> id_to_hit_energy_map;
+  caf::TrackIDMap<std::pair<geo::WireID, const sim::IDE*>> id_to_ide_map;
+  caf::TrackIDMap<art::Ptr<recob::Hit>> id_to_truehit_map;
+  caf::TrackIDMap<caf::HitsEnergy> id_to_hit_energy_map;
+
+  // Backtracked truth of each hit, filled once and shared by all of the
+  // truth matching below
+  CAFRecoUtils::HitTruthCache hit_truth;
+  const cheat::BackTrackerService *backtracker = isRealData ? nullptr : art::ServiceHandle<cheat::BackTrackerService>().get();
+
+  fPerf.Count(PerfMonitor::kHits, hits.size());
+  fMemory.Mark("inputs");
 
   if ( !isRealData ) {
-    art::ServiceHandle<cheat::BackTrackerService> bt_serv;
+    PerfMonitor::Scope scope(fPerf, PerfMonitor::kTruthPrep);
+
+    art::ServiceHandle<cheat::ParticleInventoryService> pi_serv;
+    hit_truth.SetShowerPrimaries(CAFRecoUtils::ShowerPrimaryTable(pi_serv->ParticleList()));
+    hit_truth.Add(hits, clock_data, *backtracker);
 
     id_to_ide_map = PrepSimChannels(simchannels, *geometry);
-    id_to_truehit_map = PrepTrueHits(hits, clock_data, *bt_serv);
-    id_to_hit_energy_map = SetupIDHitEnergyMap(hits, clock_data, *bt_serv);
+    id_to_truehit_map = PrepTrueHits(hits, hit_truth);
+    id_to_hit_energy_map = SetupIDHitEnergyMap(hits, hit_truth);
+  }
+
+  fMemory.Mark("truth_prep");
+  if (fMemory.Enabled()) {
+    fMemory.Size("id_to_ide_map", HeapBytes(id_to_ide_map));
+    fMemory.Size("id_to_truehit_map", HeapBytes(id_to_truehit_map));
+    fMemory.Size("id_to_hit_energy_map", HeapBytes(id_to_hit_energy_map));
   }
 
   //#######################################################
@@ -906,29 +1592,65 @@ void CAFMaker::produce(art::Event& evt) noexcept {
   caf::SRTruthBranch                  srtruthbranch;
 
   if (mc_particles.isValid()) {
-    art::ServiceHandle<cheat::ParticleInventoryService> pi_serv;
-    art::ServiceHandle<cheat::BackTrackerService> bt_serv;
+    PerfMonitor::Scope scope(fPerf, PerfMonitor::kTrueParticles);
+    fPerf.Count(PerfMonitor::kTrueParticleCount, mc_particles->size());
 
-    for (const simb::MCParticle part: *mc_particles) {
-      true_particles.emplace_back();
+    // Index into mctruths of the interaction of each particle. The
+    // inventory service is not safe to call concurrently, so this is done
+    // up front, before the particles are filled.
+    art::ServiceHandle<cheat::ParticleInventoryService> pi_serv;
+    std::vector<int> interaction_ids(mc_particles->size(), -1);
+    for (size_t i_part = 0; i_part < mc_particles->size(); i_part++) {
+      art::Ptr<simb::MCTruth> truth = pi_serv->TrackIdToMCTruth_P((*mc_particles)[i_part].TrackId());
+      for (unsigned i = 0; i < mctruths.size(); i++) {
+        if (truth.get() == mctruths[i].get()) {
+          interaction_ids[i_part] = i;
+          break;
+        }
+      }
+    }
 
-      FillTrueG4Particle(part,
+    true_particles.resize(mc_particles->size());
+    auto fill_particle = [&](size_t i_part) {
+      FillTrueG4Particle((*mc_particles)[i_part],
                          fActiveVolumes,
                          fTPCVolumes,
                          id_to_ide_map,
                          id_to_truehit_map,
-                         *bt_serv,
-                         *pi_serv,
-                         mctruths,
-                         true_particles.back());
+                         interaction_ids[i_part],
+                         true_particles[i_part]);
+    };
+    if (fParams.NTrueParticleThreads() > 1) {
+      tbb::task_arena arena(fParams.NTrueParticleThreads());
+      arena.execute([&]() {
+        tbb::parallel_for(size_t(0), mc_particles->size(), fill_particle);
+      });
+    }
+    else {
+      for (size_t i_part = 0; i_part < mc_particles->size(); i_part++) fill_particle(i_part);
     }
   }
 
+  fMemory.Mark("true_particles");
+  fMemory.Size("true_particles", true_particles.capacity() * sizeof(caf::SRTrueParticle));
+
+  PerfMonitor::Scope interactions_scope(fPerf, PerfMonitor::kTrueInteractions);
+
   std::vector<art::FindManyP<sbn::evwgh::EventWeightMap>> fmpewm;
 
   // holder for invalid MCFlux
   simb::MCFlux badflux; // default constructor gives nonsense values
 
+  // Indices of the particles of each interaction, so that each interaction
+  // only looks at its own particles
+  std::vector<std::vector<unsigned>> interaction_particles(mctruths.size());
+  for (unsigned i_part = 0; i_part < true_particles.size(); i_part++) {
+    const int interaction_id = true_particles[i_part].interaction_id;
+    if (interaction_id >= 0 && interaction_id < (int)mctruths.size()) {
+      interaction_particles[interaction_id].push_back(i_part);
+    }
+  }
+
   for (size_t i=0; i<mctruths.size(); i++) {
     auto const& mctruth = mctruths.at(i);
     const simb::MCFlux &mcflux = (mcfluxes.size()) ? *mcfluxes.at(i) : badflux;
@@ -942,7 +1664,7 @@ void CAFMaker::produce(art::Event& evt) noexcept {
     srtruthbranch.nu.push_back(SRTrueInteraction());
     srtruthbranch.nnu ++;
 
-    if ( !isRealData ) FillTrueNeutrino(mctruth, mcflux, gtruth, true_particles, id_to_truehit_map, srtruthbranch.nu.back(), i, fActiveVolumes);
+    if ( !isRealData ) FillTrueNeutrino(mctruth, mcflux, gtruth, true_particles, interaction_particles[i], id_to_truehit_map, srtruthbranch.nu.back(), i, fActiveVolumes);
 
     // Don't check for syst weight assocations until we have something (MCTruth
     // corresponding to a neutrino) that could plausibly be reweighted. This
@@ -968,22 +1690,31 @@ void CAFMaker::produce(art::Event& evt) noexcept {
     } // end for fm
   } // end for i (mctruths)
 
-  // get the number of events generated in the gen stage
-  unsigned n_gen_evt = 0;
-  for (const art::ProcessConfiguration &process: evt.processHistory()) {
-    fhicl::ParameterSet gen_config;
-    bool success = evt.getProcessParameterSet(process.processName(), gen_config);
-    if (success && gen_config.has_key("source") && gen_config.has_key("source.maxEvents") && gen_config.has_key("source.module_type") ) {
-      int max_events = gen_config.get<int>("source.maxEvents");
-      std::string module_type = gen_config.get<std::string>("source.module_type");
-      if (module_type == "EmptyEvent") {
-        n_gen_evt += max_events;
+  // get the number of events generated in the gen stage. It only depends
+  // on the process history, which rarely changes between events.
+  if (evt.processHistoryID() != fNGenEvtHistoryID) {
+    fNGenEvtHistoryID = evt.processHistoryID();
+    fNGenEvt = 0;
+    for (const art::ProcessConfiguration &process: evt.processHistory()) {
+      fhicl::ParameterSet gen_config;
+      bool success = evt.getProcessParameterSet(process.processName(), gen_config);
+      if (success && gen_config.has_key("source") && gen_config.has_key("source.maxEvents") && gen_config.has_key("source.module_type") ) {
+        int max_events = gen_config.get<int>("source.maxEvents");
+        std::string module_type = gen_config.get<std::string>("source.module_type");
+        if (module_type == "EmptyEvent") {
+          fNGenEvt += max_events;
+        }
       }
     }
   }
+  const unsigned n_gen_evt = fNGenEvt;
+
+  // Fake reco of each MCTruth, here and per slice below, only looks at
+  // the primary tracks from its own vertex
+  const std::vector<std::vector<unsigned>> fakereco_tracks = PrepFakeRecoTracks(mctruths, mctracks);
 
   std::vector<caf::SRFakeReco> srfakereco;
-  FillFakeReco(mctruths, mctracks, fActiveVolumes, *fFakeRecoTRandom, srfakereco);
+  FillFakeReco(mctruths, mctracks, fakereco_tracks, fActiveVolumes, *fFakeRecoTRandom, srfakereco);
 
   // Fill the MeVPrtl stuff
   for (unsigned i_prtl = 0; i_prtl < mevprtl_truths.size(); i_prtl++) {
@@ -992,6 +1723,9 @@ void CAFMaker::produce(art::Event& evt) noexcept {
     srtruthbranch.nprtl = srtruthbranch.prtl.size();
   } 
 
+  interactions_scope.Stop();
+  fMemory.Mark("true_interactions");
+
   //#######################################################
   // Fill detector & reco
   //#######################################################
@@ -1086,389 +1820,122 @@ void CAFMaker::produce(art::Event& evt) noexcept {
   // Branch entry definition -- contains list of slices, CRT information, and truth information
   StandardRecord rec;
 
+  // Associations looked up per slice are indexed once per event
+  EventAssnCache assn_cache(evt);
+
   //#######################################################
-  // Loop over slices
+  // Gather the inputs of, and select, the slices
   //#######################################################
+  // Everything which touches the event or services is done serially here
+  fMemory.Mark("detector");
+  PerfMonitor::Scope gather_scope(fPerf, PerfMonitor::kSliceGather);
+  fPerf.Count(PerfMonitor::kSlices, slices.size());
+
+  std::vector<SliceInputs> slice_inputs;
+  std::vector<caf::SRSlice> slice_records;
   for (unsigned sliceID = 0; sliceID < slices.size(); sliceID++) {
     // Holder for information on this slice
     caf::SRSlice recslc;
     recslc.truth.det = fDet;
 
-    art::Ptr<recob::Slice> slice = slices[sliceID];
-    const std::string &slice_tag_suff = slice_tag_suffixes[sliceID];
-    unsigned producer = slice_tag_indices[sliceID];
-
-    // Get tracks & showers here
-    std::vector<art::Ptr<recob::Slice>> sliceList {slice};
-    art::FindManyP<recob::PFParticle> findManyPFParts =
-       FindManyPStrict<recob::PFParticle>(sliceList, evt,  fParams.PFParticleLabel() + slice_tag_suff);
-
-    std::vector<art::Ptr<recob::PFParticle>> fmPFPart;
-    if (findManyPFParts.isValid()) {
-      fmPFPart = findManyPFParts.at(0);
-    }
-
-    art::FindManyP<recob::Hit> fmSlcHits =
-      FindManyPStrict<recob::Hit>(sliceList, evt,
-          fParams.PFParticleLabel() + slice_tag_suff);
-    std::vector<art::Ptr<recob::Hit>> slcHits;
-    if (fmSlcHits.isValid()) {
-      slcHits = fmSlcHits.at(0);
-    }
-
-    art::FindOneP<sbn::CRUMBSResult> foSlcCRUMBS =
-      FindOnePStrict<sbn::CRUMBSResult>(sliceList, evt,
-          fParams.CRUMBSLabel() + slice_tag_suff);
-    const sbn::CRUMBSResult *slcCRUMBS = nullptr;
-    if (foSlcCRUMBS.isValid()) {
-      slcCRUMBS = foSlcCRUMBS.at(0).get();
-    }
-
-    art::FindManyP<sbn::SimpleFlashMatch> fm_sFM =
-      FindManyPStrict<sbn::SimpleFlashMatch>(fmPFPart, evt,
-                                             fParams.FlashMatchLabel() + slice_tag_suff);
-
-    art::FindManyP<larpandoraobj::PFParticleMetadata> fmPFPMeta =
-      FindManyPStrict<larpandoraobj::PFParticleMetadata>(fmPFPart, evt,
-               fParams.PFParticleLabel() + slice_tag_suff);
-
-    art::FindManyP<recob::Shower> fmShower =
-      FindManyPStrict<recob::Shower>(fmPFPart, evt, fParams.RecoShowerLabel() + slice_tag_suff);
-
-    // make Ptr's to showers for shower -> other object associations
-    std::vector<art::Ptr<recob::Shower>> slcShowers;
-    if (fmShower.isValid()) {
-      for (unsigned i = 0; i < fmShower.size(); i++) {
-        const std::vector<art::Ptr<recob::Shower>> &thisShowers = fmShower.at(i);
-        if (thisShowers.size() == 0) {
-          slcShowers.emplace_back(); // nullptr
-        }
-        else if (thisShowers.size() == 1) {
-          slcShowers.push_back(fmShower.at(i).at(0));
-        }
-        else assert(false); // bad
-      }
-    }
-
-    art::FindManyP<float> fmShowerCosmicDist =
-      FindManyPStrict<float>(slcShowers, evt, fParams.ShowerCosmicDistLabel() + slice_tag_suff);
-
-    art::FindManyP<float> fmShowerResiduals =
-      FindManyPStrict<float>(slcShowers, evt, fParams.RecoShowerSelectionLabel() + slice_tag_suff);
-
-    art::FindManyP<sbn::ShowerTrackFit> fmShowerTrackFit =
-      FindManyPStrict<sbn::ShowerTrackFit>(slcShowers, evt, fParams.RecoShowerSelectionLabel() + slice_tag_suff);
-
-    art::FindManyP<sbn::ShowerDensityFit> fmShowerDensityFit =
-      FindManyPStrict<sbn::ShowerDensityFit>(slcShowers, evt, fParams.RecoShowerSelectionLabel() + slice_tag_suff);
-
-    art::FindManyP<recob::Track> fmTrack =
-      FindManyPStrict<recob::Track>(fmPFPart, evt,
-            fParams.RecoTrackLabel() + slice_tag_suff);
-
-    // make Ptr's to tracks for track -> other object associations
-    std::vector<art::Ptr<recob::Track>> slcTracks;
-    if (fmTrack.isValid()) {
-      for (unsigned i = 0; i < fmTrack.size(); i++) {
-        const std::vector<art::Ptr<recob::Track>> &thisTracks = fmTrack.at(i);
-        if (thisTracks.size() == 0) {
-          slcTracks.emplace_back(); // nullptr
-        }
-        else if (thisTracks.size() == 1) {
-          slcTracks.push_back(fmTrack.at(i).at(0));
-        }
-        else assert(false); // bad
-      }
-    }
-
-    // Get the stubs!
-    art::FindManyP<sbn::Stub> fmSlcStubs =
-      FindManyPStrict<sbn::Stub>(sliceList, evt,
-          fParams.StubLabel() + slice_tag_suff);
-
-    std::vector<art::Ptr<sbn::Stub>> fmStubs;
-    if (fmSlcStubs.isValid()) {
-      fmStubs = fmSlcStubs.at(0);
-    } 
-
-    // Lookup stubs to overlaid PFP
-    art::FindManyP<recob::PFParticle> fmStubPFPs =
-      FindManyPStrict<recob::PFParticle>(fmStubs, evt,
-          fParams.StubLabel() + slice_tag_suff);
-    // and get the stub hits for truth matching
-    art::FindManyP<recob::Hit> fmStubHits =
-      FindManyPStrict<recob::Hit>(fmStubs, evt,
-          fParams.StubLabel() + slice_tag_suff);
-
-    art::FindManyP<anab::Calorimetry> fmCalo =
-      FindManyPStrict<anab::Calorimetry>(slcTracks, evt,
-           fParams.TrackCaloLabel() + slice_tag_suff);
-
-    art::FindManyP<anab::ParticleID> fmChi2PID =
-      FindManyPStrict<anab::ParticleID>(slcTracks, evt,
-          fParams.TrackChi2PidLabel() + slice_tag_suff);
-
-    art::FindManyP<sbn::ScatterClosestApproach> fmScatterClosestApproach =
-      FindManyPStrict<sbn::ScatterClosestApproach>(slcTracks, evt,
-          fParams.TrackScatterClosestApproachLabel() + slice_tag_suff);
-
-    art::FindManyP<sbn::StoppingChi2Fit> fmStoppingChi2Fit =
-      FindManyPStrict<sbn::StoppingChi2Fit>(slcTracks, evt,
-          fParams.TrackStoppingChi2FitLabel() + slice_tag_suff);
-
-    art::FindManyP<sbn::MVAPID> fmTrackDazzle =
-      FindManyPStrict<sbn::MVAPID>(slcTracks, evt,
-          fParams.TrackDazzleLabel() + slice_tag_suff);
-
-    art::FindManyP<sbn::MVAPID> fmShowerRazzle =
-      FindManyPStrict<sbn::MVAPID>(slcShowers, evt,
-          fParams.ShowerRazzleLabel() + slice_tag_suff);
-
-    art::FindManyP<recob::Vertex> fmVertex =
-      FindManyPStrict<recob::Vertex>(fmPFPart, evt,
-             fParams.PFParticleLabel() + slice_tag_suff);
-
-    art::FindManyP<recob::Hit> fmTrackHit =
-      FindManyPStrict<recob::Hit>(slcTracks, evt,
-          fParams.RecoTrackLabel() + slice_tag_suff);
-
-    art::FindManyP<recob::Hit> fmShowerHit =
-      FindManyPStrict<recob::Hit>(slcShowers, evt,
-          fParams.RecoShowerLabel() + slice_tag_suff);
-
-    // TODO: also save the sbn::crt::CRTHit in the matching so that CAFMaker has access to it
-    art::FindManyP<anab::T0> fmCRTHitMatch =
-      FindManyPStrict<anab::T0>(slcTracks, evt,
-               fParams.CRTHitMatchLabel() + slice_tag_suff);
-
-    // TODO: also save the sbn::crt::CRTTrack in the matching so that CAFMaker has access to it
-    art::FindManyP<anab::T0> fmCRTTrackMatch =
-      FindManyPStrict<anab::T0>(slcTracks, evt,
-               fParams.CRTTrackMatchLabel() + slice_tag_suff);
-
-    std::vector<art::FindManyP<recob::MCSFitResult>> fmMCSs;
-    static const std::vector<std::string> PIDnames {"muon", "pion", "kaon", "proton"};
-    for (std::string pid: PIDnames) {
-      art::InputTag tag(fParams.TrackMCSLabel() + slice_tag_suff, pid);
-      fmMCSs.push_back(FindManyPStrict<recob::MCSFitResult>(slcTracks, evt, tag));
-    }
-
-    std::vector<art::FindManyP<sbn::RangeP>> fmRanges;
-    static const std::vector<std::string> rangePIDnames {"muon", "pion", "proton"};
-    for (std::string pid: rangePIDnames) {
-      art::InputTag tag(fParams.TrackRangeLabel() + slice_tag_suff, pid);
-      fmRanges.push_back(FindManyPStrict<sbn::RangeP>(slcTracks, evt, tag));
-    }
+    SliceInputs in = GatherSliceInputs(evt, slices[sliceID], slice_tag_suffixes[sliceID],
+                                       slice_tag_indices[sliceID], assn_cache);
 
     //    if (slice.IsNoise() || slice.NCell() == 0) continue;
     // Because we don't care about the noise slice and slices with no hits.
 
-    // get the primary particle
-    size_t iPart;
-    for (iPart = 0; iPart < fmPFPart.size(); ++iPart ) {
-      const recob::PFParticle &thisParticle = *fmPFPart[iPart];
-      if (thisParticle.IsPrimary()) break;
-    }
-    // primary particle and meta-data
-    const recob::PFParticle *primary = (iPart == fmPFPart.size()) ? NULL : fmPFPart[iPart].get();
-    const larpandoraobj::PFParticleMetadata *primary_meta = (iPart == fmPFPart.size()) ? NULL : fmPFPMeta.at(iPart).at(0).get();
-    // get the flash match
-    const sbn::SimpleFlashMatch* fmatch = nullptr;
-    if (fm_sFM.isValid() && primary != NULL) {
-      std::vector<art::Ptr<sbn::SimpleFlashMatch>> fmatches = fm_sFM.at(iPart);
-      if (fmatches.size() != 0) {
-        assert(fmatches.size() == 1);
-        fmatch = fmatches[0].get();
-      }
-    }
-    // get the primary vertex
-    const recob::Vertex *vertex = (iPart == fmPFPart.size() || !fmVertex.at(iPart).size()) ? NULL : fmVertex.at(iPart).at(0).get();
-
     //#######################################################
     // Add slice info.
     //#######################################################
-    FillSliceVars(*slice, primary, producer, recslc);
-    FillSliceMetadata(primary_meta, recslc);
-    FillSliceFlashMatch(fmatch, recslc);
-    FillSliceFlashMatchA(fmatch, recslc);
-    FillSliceVertex(vertex, recslc);
-    FillSliceCRUMBS(slcCRUMBS, recslc);
+    FillSliceVars(*in.slice, in.primary, in.producer, recslc);
+    FillSliceMetadata(in.primary_meta, recslc);
+    FillSliceFlashMatch(in.fmatch, recslc);
+    FillSliceFlashMatchA(in.fmatch, recslc);
+    FillSliceVertex(in.vertex, recslc);
+    FillSliceCRUMBS(in.slcCRUMBS, recslc);
 
     // select slice
     if (!SelectSlice(recslc, fParams.CutClearCosmic())) continue;
 
-    // Whether Pandora thinks this slice is a neutrino
-    //
-    // This requirement is used to determine whether to save additional
-    // per-hit information about the slice.
-    bool NeutrinoSlice = !recslc.is_clear_cosmic;
-
-    // Fill truth info after decision on selection is made
+    // Backtrack the hits of the slice and of its objects up front, so that
+    // the truth matching below only reads the cache
     if ( !isRealData ) {
-      art::ServiceHandle<cheat::ParticleInventoryService> pi_serv;
-
-      FillSliceTruth(slcHits, mctruths, srtruthbranch,
-		     *pi_serv, clock_data, recslc);
-
-      FillSliceFakeReco(slcHits, mctruths, srtruthbranch,
-			*pi_serv, clock_data, recslc, mctracks, fActiveVolumes,
-			*fFakeRecoTRandom);
-    }
-
-    //#######################################################
-    // Add detector dependent slice info.
-    //#######################################################
-    // if (fDet == kSBND) {
-    //   rec.sel.contain.nplanestofront = rec.slc.firstplane - (plnfirst - 1);
-    //   rec.sel.contain.nplanestoback = (plnlast) - 1 - rec.slc.lastplane;
-    // }
-
-    //#######################################################
-    // Add stub reconstructed objects.
-    //#######################################################
-    for (size_t iStub = 0; iStub < fmStubs.size(); iStub++) {
-      const sbn::Stub &thisStub = *fmStubs[iStub];
-
-      art::Ptr<recob::PFParticle> thisStubPFP;
-      if (!fmStubPFPs.at(iStub).empty()) thisStubPFP = fmStubPFPs.at(iStub).at(0);
-
-      rec.reco.stub.emplace_back();
-      FillStubVars(thisStub, thisStubPFP, rec.reco.stub.back());
-      if ( !isRealData ) FillStubTruth(fmStubHits.at(iStub), id_to_hit_energy_map, true_particles, clock_data, rec.reco.stub.back());
-      rec.reco.nstub = rec.reco.stub.size();
-
-      // Duplicate stub reco info in the srslice
-      recslc.reco.stub.push_back(rec.reco.stub.back());
-      recslc.reco.nstub = recslc.reco.stub.size();
-    }
-
-    //#######################################################
-    // Add track/shower reconstructed objects.
-    //#######################################################
-    // Reco objects have assns to the slice PFParticles
-    // This depends on the findMany object created above.
-    for ( size_t iPart = 0; iPart < fmPFPart.size(); ++iPart ) {
-      const recob::PFParticle &thisParticle = *fmPFPart[iPart];
-
-      std::vector<art::Ptr<recob::Track>> thisTrack;
-      if (fmTrack.isValid()) {
-        thisTrack = fmTrack.at(iPart);
+      hit_truth.Add(in.slcHits, clock_data, *backtracker);
+      for (size_t i = 0; i < in.fmStubHits.size(); i++) hit_truth.Add(in.fmStubHits.at(i), clock_data, *backtracker);
+      if (in.fmTrackHit.isValid()) {
+        for (size_t i = 0; i < in.fmTrackHit.size(); i++) hit_truth.Add(in.fmTrackHit.at(i), clock_data, *backtracker);
       }
-      std::vector<art::Ptr<recob::Shower>> thisShower;
-      if (fmShower.isValid()) {
-        thisShower = fmShower.at(iPart);
+      if (in.fmShowerHit.isValid()) {
+        for (size_t i = 0; i < in.fmShowerHit.size(); i++) hit_truth.Add(in.fmShowerHit.at(i), clock_data, *backtracker);
       }
+    }
 
-      if (!thisTrack.empty())  { // it's a track!
-        assert(thisTrack.size() == 1);
-        assert(thisShower.size() == 0);
-        rec.reco.ntrk ++;
-        rec.reco.trk.push_back(SRTrack());
-
-        // collect all the stuff
-        std::array<std::vector<art::Ptr<recob::MCSFitResult>>, 4> trajectoryMCS;
-        for (unsigned index = 0; index < 4; index++) {
-          if (fmMCSs[index].isValid()) {
-            trajectoryMCS[index] = fmMCSs[index].at(iPart);
-          }
-          else {
-            trajectoryMCS[index] = std::vector<art::Ptr<recob::MCSFitResult>>();
-          }
-        }
-
-        std::array<std::vector<art::Ptr<sbn::RangeP>>, 3> rangePs;
-        for (unsigned index = 0; index < 3; index++) {
-          if (fmRanges[index].isValid()) {
-            rangePs[index] = fmRanges[index].at(iPart);
-          }
-          else {
-            rangePs[index] = std::vector<art::Ptr<sbn::RangeP>>();
-          }
-        }
-
-
-        // fill all the stuff
-        FillTrackVars(*thisTrack[0], producer, rec.reco.trk.back());
-        FillTrackMCS(*thisTrack[0], trajectoryMCS, rec.reco.trk.back());
-        FillTrackRangeP(*thisTrack[0], rangePs, rec.reco.trk.back());
+    fPerf.Count(PerfMonitor::kSelectedSlices);
+    fPerf.Count(PerfMonitor::kPFPs, in.fmPFPart.size());
 
-        const larpandoraobj::PFParticleMetadata *pfpMeta = (fmPFPMeta.at(iPart).empty()) ? NULL : fmPFPMeta.at(iPart).at(0).get();
-        FillPFPVars(thisParticle, primary, pfpMeta, rec.reco.trk.back().pfp);
+    slice_inputs.push_back(std::move(in));
+    slice_records.push_back(std::move(recslc));
+  }
 
-        if (fmChi2PID.isValid()) {
-           FillTrackChi2PID(fmChi2PID.at(iPart), lar::providerFrom<geo::Geometry>(), rec.reco.trk.back());
-        }
-        if (fmScatterClosestApproach.isValid() && fmScatterClosestApproach.at(iPart).size()==1) {
-           FillTrackScatterClosestApproach(fmScatterClosestApproach.at(iPart).front(), rec.reco.trk.back());
-        }
-        if (fmStoppingChi2Fit.isValid() && fmStoppingChi2Fit.at(iPart).size()==1) {
-           FillTrackStoppingChi2Fit(fmStoppingChi2Fit.at(iPart).front(), rec.reco.trk.back());
-        }
-        if (fmTrackDazzle.isValid() && fmTrackDazzle.at(iPart).size()==1) {
-           FillTrackDazzle(fmTrackDazzle.at(iPart).front(), rec.reco.trk.back());
-        }
-        if (fmCalo.isValid()) {
-          FillTrackCalo(fmCalo.at(iPart), fmTrackHit.at(iPart),
-              (fParams.FillHitsNeutrinoSlices() && NeutrinoSlice) || fParams.FillHitsAllSlices(), 
-              fParams.TrackHitFillRRStartCut(), fParams.TrackHitFillRREndCut(),
-              lar::providerFrom<geo::Geometry>(), dprop, rec.reco.trk.back());
-        }
-        if (fmTrackHit.isValid()) {
-          if ( !isRealData ) FillTrackTruth(fmTrackHit.at(iPart), id_to_hit_energy_map, true_particles, clock_data, rec.reco.trk.back());
-        }
-        // NOTE: SEE TODO's AT fmCRTHitMatch and fmCRTTrackMatch
-        if (fmCRTHitMatch.isValid()) {
-          FillTrackCRTHit(fmCRTHitMatch.at(iPart), rec.reco.trk.back());
-        }
-        if (fmCRTTrackMatch.isValid()) {
-          FillTrackCRTTrack(fmCRTTrackMatch.at(iPart), rec.reco.trk.back());
-        }
-        // Duplicate track reco info in the srslice
-        recslc.reco.trk.push_back(rec.reco.trk.back());
-        recslc.reco.ntrk = recslc.reco.trk.size();
-      } // thisTrack exists
+  gather_scope.Stop();
+  fMemory.Mark("slice_gather");
 
-      else if (!thisShower.empty()) { // it's a shower!
-        assert(thisTrack.size() == 0);
-        assert(thisShower.size() == 1);
-        rec.reco.nshw ++;
-        rec.reco.shw.push_back(SRShower());
-        FillShowerVars(*thisShower[0], vertex, fmShowerHit.at(iPart), lar::providerFrom<geo::Geometry>(), producer, rec.reco.shw.back());
+  //#######################################################
+  // Fill the reco objects of each selected slice
+  //#######################################################
+  PerfMonitor::Scope reco_scope(fPerf, PerfMonitor::kSliceReco);
+
+  auto fill_slice = [&](size_t i) {
+    FillSliceReco(slice_inputs[i], isRealData, hit_truth, id_to_hit_energy_map,
+                  true_particles, geometry, dprop, slice_records[i]);
+  };
+  if (fParams.NSliceThreads() > 1 && slice_records.size() > 1) {
+    tbb::task_arena arena(fParams.NSliceThreads());
+    arena.execute([&]() {
+      tbb::parallel_for(size_t(0), slice_records.size(), fill_slice);
+    });
+  }
+  else {
+    for (size_t i = 0; i < slice_records.size(); i++) fill_slice(i);
+  }
 
-        const larpandoraobj::PFParticleMetadata *pfpMeta = (iPart == fmPFPart.size()) ? NULL : fmPFPMeta.at(iPart).at(0).get();
-        FillPFPVars(thisParticle, primary, pfpMeta, rec.reco.shw.back().pfp);
+  reco_scope.Stop();
+  fMemory.Mark("slice_reco");
 
-        // We may have many residuals per shower depending on how many showers ar in the slice
+  //#######################################################
+  // Slice truth, and merge into the record in slice order
+  //#######################################################
+  PerfMonitor::Scope truth_scope(fPerf, PerfMonitor::kSliceTruth);
 
-        if (fmShowerRazzle.isValid() && fmShowerRazzle.at(iPart).size()==1) {
-           FillShowerRazzle(fmShowerRazzle.at(iPart).front(), rec.reco.shw.back());
-        }
-        if (fmShowerCosmicDist.isValid() && fmShowerCosmicDist.at(iPart).size() != 0) {
-          FillShowerCosmicDist(fmShowerCosmicDist.at(iPart), rec.reco.shw.back());
-        }
-        if (fmShowerResiduals.isValid() && fmShowerResiduals.at(iPart).size() != 0) {
-          FillShowerResiduals(fmShowerResiduals.at(iPart), rec.reco.shw.back());
-        }
-        if (fmShowerTrackFit.isValid() && fmShowerTrackFit.at(iPart).size()  == 1) {
-          FillShowerTrackFit(*fmShowerTrackFit.at(iPart).front(), rec.reco.shw.back());
-        }
-        if (fmShowerDensityFit.isValid() && fmShowerDensityFit.at(iPart).size() == 1) {
-          FillShowerDensityFit(*fmShowerDensityFit.at(iPart).front(), rec.reco.shw.back());
-        }
-        if (fmShowerHit.isValid()) {
-          if ( !isRealData ) FillShowerTruth(fmShowerHit.at(iPart), id_to_hit_energy_map, true_particles, clock_data, rec.reco.shw.back());
-        }
-        // Duplicate track reco info in the srslice
-        recslc.reco.shw.push_back(rec.reco.shw.back());
-        recslc.reco.nshw = recslc.reco.shw.size();
+  // Slice truth matching, shared by all of the slice-level truth fillers
+  std::unique_ptr<SliceTruthMatcher> slice_matcher;
+  if ( !isRealData ) {
+    art::ServiceHandle<cheat::ParticleInventoryService> pi_serv;
+    slice_matcher = std::make_unique<SliceTruthMatcher>(mctruths, srtruthbranch, *pi_serv, hit_truth);
+  }
 
-      } // thisShower exists
+  for (size_t i = 0; i < slice_records.size(); i++) {
+    caf::SRSlice& recslc = slice_records[i];
 
-      else {}
+    // Fill truth info after decision on selection is made. Fake reco draws
+    // from the random number generator, so this stays in slice order.
+    if ( !isRealData ) {
+      const caf::SRTruthMatch tmatch = slice_matcher->Match(slice_inputs[i].slcHits);
 
-    }// end for pfparts
+      FillSliceTruth(tmatch, srtruthbranch, recslc);
 
+      FillSliceFakeReco(tmatch, mctruths, recslc, mctracks, fakereco_tracks, fActiveVolumes,
+			*fFakeRecoTRandom);
+    }
 
+    // The slice reco objects are duplicated at the top level of the record,
+    // which is the only copy needed: the slice itself is moved in below
+    rec.reco.stub.insert(rec.reco.stub.end(), recslc.reco.stub.begin(), recslc.reco.stub.end());
+    rec.reco.nstub = rec.reco.stub.size();
+    rec.reco.trk.insert(rec.reco.trk.end(), recslc.reco.trk.begin(), recslc.reco.trk.end());
+    rec.reco.ntrk += recslc.reco.trk.size();
+    rec.reco.shw.insert(rec.reco.shw.end(), recslc.reco.shw.begin(), recslc.reco.shw.end());
+    rec.reco.nshw += recslc.reco.shw.size();
 
     //#######################################################
     // Fill slice in rec tree
@@ -1480,26 +1947,32 @@ void CAFMaker::produce(art::Event& evt) noexcept {
     //util::CreateAssn(*this, evt, *srcol, art::Ptr<recob::Slice>(slices, sliceID),
     //                 *srAssn);
 
-    rec.slc.push_back(recslc);
+    rec.slc.push_back(std::move(recslc));
 
   }  // end loop over slices
 
+  truth_scope.Stop();
+  fMemory.Mark("slice_truth");
+  fPerf.Count(PerfMonitor::kBacktrackedHits, hit_truth.NHits());
+
   //#######################################################
   //  Fill rec Tree
   //#######################################################
+  // Nothing reads the event-level products after this point, so they are
+  // moved into the record rather than copied. Take the sizes first.
   rec.nslc            = rec.slc.size();
-  rec.mc              = srtruthbranch;
-  rec.fake_reco       = srfakereco;
   rec.nfake_reco      = srfakereco.size();
-  rec.pass_flashtrig  = pass_flash_trig;  // trigger result
-  rec.crt_hits        = srcrthits;
   rec.ncrt_hits       = srcrthits.size();
-  rec.crt_tracks        = srcrttracks;
   rec.ncrt_tracks       = srcrttracks.size();
+  rec.ntrue_particles = true_particles.size();
+  rec.mc              = std::move(srtruthbranch);
+  rec.fake_reco       = std::move(srfakereco);
+  rec.pass_flashtrig  = pass_flash_trig;  // trigger result
+  rec.crt_hits        = std::move(srcrthits);
+  rec.crt_tracks        = std::move(srcrttracks);
   if (fParams.FillTrueParticles()) {
-    rec.true_particles  = true_particles;
+    rec.true_particles  = std::move(true_particles);
   }
-  rec.ntrue_particles = true_particles.size();
 
   // Get metadata information for header
   unsigned int run = evt.run();
@@ -1507,39 +1980,22 @@ void CAFMaker::produce(art::Event& evt) noexcept {
   unsigned int evtID = evt.event();
   //   unsigned int spillNum = evt.id().event();
 
-  rec.hdr = SRHeader();
-
-  // Get the Process and Cluser number
-  const char *process_str = std::getenv("PROCESS");
-  if (process_str) {
-    try {
-      rec.hdr.proc = std::stoi(process_str);
-    }
-    catch (...) {}
-  }
-
-  const char *cluster_str = std::getenv("CLUSTER");
-  if (cluster_str) {
-    try {
-      rec.hdr.cluster = std::stoi(cluster_str);
-    }
-    catch (...) {}
-  }
+  // proc, cluster and det
+  rec.hdr = fHeaderTemplate;
 
   rec.hdr.run     = run;
   rec.hdr.subrun  = subrun;
   rec.hdr.evt     = evtID;
   // rec.hdr.subevt = sliceID;
   rec.hdr.ismc    = !isRealData;
-  rec.hdr.det     = fDet;
   rec.hdr.fno     = fFileNumber;
   if(fFirstInFile)
   {
     rec.hdr.pot   = fSubRunPOT;
     rec.hdr.nbnbinfo = fBNBInfo.size();
-    rec.hdr.bnbinfo = fBNBInfo;
+    rec.hdr.bnbinfo = std::move(fBNBInfo);
     rec.hdr.nnumiinfo = fNuMIInfo.size();
-    rec.hdr.numiinfo = fNuMIInfo;
+    rec.hdr.numiinfo = std::move(fNuMIInfo);
   }
   rec.hdr.ngenevt = n_gen_evt;
   rec.hdr.mctype  = mctype;
@@ -1554,25 +2010,29 @@ void CAFMaker::produce(art::Event& evt) noexcept {
   fFirstInFile = false;
   fFirstInSubRun = false;
 
-  if(fRecTree){
-    // Save the standard-record
-    StandardRecord* prec = &rec;
-    fRecTree->SetBranchAddress("rec", &prec);
-    fRecTree->Fill();
+  if(fWriter){
+    // The writer thread takes the record, so art gets a copy
+    if (fParams.CreateArtProduct()) srcol->push_back(rec);
+    try{
+      fWriter->Push(std::move(rec));
+    }
+    catch(std::exception& e){
+      std::cout << "CAFMaker: writing a previous record failed: " << e.what() << std::endl;
+      abort();
+    }
   }
-
-  if(fFlatTree){
-    fFlatRecord->Clear();
-    fFlatRecord->Fill(rec);
-    fFlatTree->Fill();
+  else{
+    WriteRecord(rec);
+    // The trees are filled, so the record itself can be handed to art
+    if (fParams.CreateArtProduct()) srcol->push_back(std::move(rec));
   }
 
-  srcol->push_back(rec);
-  evt.put(std::move(srcol));
+  if (fParams.CreateArtProduct()) evt.put(std::move(srcol));
+  fMemory.Mark("write");
 
+  // clear() also puts the moved-from vectors back in a known state
   fBNBInfo.clear();
   fNuMIInfo.clear();
-  rec.hdr.pot = 0;
 }
 
 void CAFMaker::endSubRun(art::SubRun& sr) {
@@ -1608,6 +2068,7 @@ void CAFMaker::endJob() {
     return;
   }
 
+  FlushWriter();
 
   if(fFile){
     // Make sure the recTree is in the file before filling other items
@@ -1625,6 +2086,14 @@ void CAFMaker::endJob() {
     fFlatFile->Write();
   }
 
+  if(fMemory.Enabled()) fMemory.Print(std::cout);
+
+  if(fPerf.Enabled()){
+    fPerf.Print(std::cout);
+    if(fFile) fPerf.WriteTree(fFile);
+    if(fFlatFile) fPerf.WriteTree(fFlatFile);
+  }
+
   std::map<std::string, std::string> metamap;
 
   try{
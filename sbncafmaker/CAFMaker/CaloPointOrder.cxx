@@ -0,0 +1,36 @@
+#include "sbncafmaker/CAFMaker/CaloPointOrder.h"
+
+#include <functional>
+
+namespace caf
+{
+  std::vector<unsigned> CaloPointOrder(const std::vector<float> &rr,
+                                       float rrstart, float rrend)
+  {
+    const float rrmax = !rr.empty() ? *std::max_element(rr.begin(), rr.end()) : 0.;
+
+    auto save_point = [&](unsigned i) {
+      return (rrmax - rr[i]) < rrstart || // near start
+        rr[i] < rrend; // near end
+    };
+
+    const bool rr_descending = std::is_sorted(rr.begin(), rr.end(), std::greater<float>());
+    const bool rr_ascending = !rr_descending && std::is_sorted(rr.begin(), rr.end());
+
+    unsigned npoints = 0;
+    for (unsigned i = 0; i < rr.size(); i++) if (save_point(i)) npoints++;
+
+    std::vector<unsigned> ret;
+    ret.reserve(npoints);
+    for (unsigned k = 0; k < rr.size(); k++) {
+      const unsigned i = rr_ascending ? rr.size() - 1 - k : k;
+      if (save_point(i)) ret.push_back(i);
+    }
+
+    if (!rr_descending && !rr_ascending) {
+      std::sort(ret.begin(), ret.end(), [&rr](unsigned lhs, unsigned rhs) { return rr[lhs] > rr[rhs]; });
+    }
+
+    return ret;
+  }
+}
@@ -0,0 +1,50 @@
+//////////////////////////////////////////////////////////////////////
+// \file    CaloPointOrder.h
+// \brief   Which calorimetry points of a track plane are saved, in which
+//          order, and the hit each one comes from
+//////////////////////////////////////////////////////////////////////
+
+#ifndef CAF_CALOPOINTORDER_H
+#define CAF_CALOPOINTORDER_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace caf
+{
+  /// \brief Indices of the points to save, by residual range hi->lo
+  ///
+  /// A point is saved if it is within \a rrstart of the largest residual
+  /// range (near the start), or has a residual range under \a rrend (near
+  /// the end). Points with the same residual range may come in any order.
+  ///
+  /// The points come in order along the track, so the residual ranges are
+  /// normally sorted one way or the other. Those cases are walked through
+  /// in order, and only other inputs are sorted.
+  std::vector<unsigned> CaloPointOrder(const std::vector<float> &rr,
+                                       float rrstart, float rrend);
+
+  /// Stable sort by \a key_of, as FindLastWithKey expects
+  template <class T, class KeyOf>
+  void SortByKey(std::vector<T> &values, KeyOf key_of)
+  {
+    std::stable_sort(values.begin(), values.end(),
+      [&key_of](const T &lhs, const T &rhs) { return key_of(lhs) < key_of(rhs); });
+  }
+
+  /// \brief Last element of \a sorted with key \a key, or null
+  ///
+  /// With \a sorted from SortByKey, this is the element a linear search
+  /// keeping the last match would find in the unsorted vector.
+  template <class T, class KeyOf>
+  const T* FindLastWithKey(const std::vector<T> &sorted, size_t key, KeyOf key_of)
+  {
+    auto it = std::upper_bound(sorted.begin(), sorted.end(), key,
+      [&key_of](size_t k, const T &v) { return k < key_of(v); });
+    if (it == sorted.begin() || key_of(*(it-1)) != key) return nullptr;
+    return &*(it-1);
+  }
+}
+
+#endif
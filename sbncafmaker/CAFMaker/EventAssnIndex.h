@@ -0,0 +1,173 @@
+//////////////////////////////////////////////////////////////////////
+// \file    EventAssnIndex.h
+// \brief   Per-event flat index of art::Assns, so that association
+//          lookups for many small "from" collections (e.g. one per
+//          slice) do not each re-scan the whole Assns product
+//////////////////////////////////////////////////////////////////////
+
+#ifndef CAF_EVENTASSNINDEX_H
+#define CAF_EVENTASSNINDEX_H
+
+#include "art/Framework/Principal/Event.h"
+#include "art/Framework/Principal/Handle.h"
+#include "canvas/Persistency/Common/Assns.h"
+#include "canvas/Persistency/Common/FindManyP.h"
+#include "canvas/Persistency/Common/FindOneP.h"
+#include "canvas/Persistency/Common/Ptr.h"
+#include "canvas/Persistency/Provenance/ProductID.h"
+#include "canvas/Utilities/InputTag.h"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <typeindex>
+#include <vector>
+
+namespace caf
+{
+  template <class L, class R> class EventAssnIndex;
+
+  /// \brief Objects associated to each element of a list of Ptr's
+  ///
+  /// Provides the subset of the art::FindManyP interface used by CAFMaker,
+  /// so it can be filled either from an EventAssnIndex or, for validation,
+  /// from an art::FindManyP / art::FindOneP.
+  template <class T>
+  class AssnLookup
+  {
+  public:
+    AssnLookup() : fValid(false) {}
+
+    explicit AssnLookup(const art::FindManyP<T>& fm)
+      : fValid(fm.isValid())
+    {
+      if (!fValid) return;
+      fResults.reserve(fm.size());
+      for (size_t i = 0; i < fm.size(); i++) fResults.push_back(fm.at(i));
+    }
+
+    explicit AssnLookup(const art::FindOneP<T>& fo)
+      : fValid(fo.isValid())
+    {
+      if (!fValid) return;
+      fResults.resize(fo.size());
+      for (size_t i = 0; i < fo.size(); i++) {
+        if (fo.at(i)) fResults[i].push_back(fo.at(i));
+      }
+    }
+
+    bool isValid() const { return fValid; }
+    size_t size() const { return fResults.size(); }
+    const std::vector<art::Ptr<T>>& at(size_t i) const { return fResults.at(i); }
+
+  private:
+    template <class L, class R> friend class EventAssnIndex;
+
+    bool fValid;
+    std::vector<std::vector<art::Ptr<T>>> fResults;
+  };
+
+  /// Type-erased base so indices of different types share one cache
+  class EventAssnIndexBase
+  {
+  public:
+    virtual ~EventAssnIndexBase() = default;
+  };
+
+  /// \brief Flat (CSR) table from the key of an L object to the range of
+  /// R objects associated to it under one input tag
+  ///
+  /// Built with a single pass over the Assns, after which each lookup costs
+  /// only the number of associated objects. Within each range, objects keep
+  /// the order they have in the Assns, which is what art::FindManyP returns.
+  template <class L, class R>
+  class EventAssnIndex : public EventAssnIndexBase
+  {
+  public:
+    EventAssnIndex(const art::Event& evt, const art::InputTag& tag)
+      : fValid(false)
+    {
+      art::Handle<art::Assns<L, R>> assns;
+      evt.getByLabel(tag, assns);
+      if (!assns.isValid()) return;
+      fValid = true;
+
+      // Count the entries of each left-hand key. Entry k+1 holds the count
+      // of key k, so that the prefix sum below yields the range starts.
+      for (const auto& assn: *assns) {
+        std::vector<unsigned>& offsets = fOffsets[assn.first.id()];
+        if (offsets.size() < assn.first.key() + 2) offsets.resize(assn.first.key() + 2, 0);
+        offsets[assn.first.key() + 1]++;
+      }
+
+      unsigned base = 0;
+      for (auto& it: fOffsets) {
+        std::vector<unsigned>& offsets = it.second;
+        offsets[0] = base;
+        for (unsigned i = 1; i < offsets.size(); i++) offsets[i] += offsets[i-1];
+        base = offsets.back();
+      }
+
+      fRight.resize(base);
+      std::map<art::ProductID, std::vector<unsigned>> cursor = fOffsets;
+      for (const auto& assn: *assns) {
+        fRight[cursor[assn.first.id()][assn.first.key()]++] = assn.second;
+      }
+    }
+
+    bool isValid() const { return fValid; }
+
+    /// Equivalent of art::FindManyP<R>(from, evt, tag)
+    AssnLookup<R> Lookup(const std::vector<art::Ptr<L>>& from) const
+    {
+      AssnLookup<R> ret;
+      ret.fValid = fValid;
+      if (!fValid) return ret;
+
+      ret.fResults.resize(from.size());
+      for (size_t i = 0; i < from.size(); i++) {
+        if (from[i].isNull()) continue;
+
+        auto it = fOffsets.find(from[i].id());
+        if (it == fOffsets.end()) continue;
+        const std::vector<unsigned>& offsets = it->second;
+        if (from[i].key() + 1 >= offsets.size()) continue;
+
+        ret.fResults[i].assign(fRight.begin() + offsets[from[i].key()],
+                               fRight.begin() + offsets[from[i].key() + 1]);
+      }
+      return ret;
+    }
+
+  private:
+    bool fValid;
+    std::map<art::ProductID, std::vector<unsigned>> fOffsets; ///< Range starts, indexed by key
+    std::vector<art::Ptr<R>> fRight;
+  };
+
+  /// Holds the EventAssnIndex's built so far for one event
+  class EventAssnCache
+  {
+  public:
+    explicit EventAssnCache(const art::Event& evt) : fEvt(evt) {}
+
+    /// Index of the Assns between L and R under \a tag, built on first use
+    template <class L, class R>
+    const EventAssnIndex<L, R>& Get(const art::InputTag& tag)
+    {
+      const Key key(tag.encode(), typeid(L), typeid(R));
+      std::unique_ptr<EventAssnIndexBase>& index = fIndices[key];
+      if (!index) index = std::make_unique<EventAssnIndex<L, R>>(fEvt, tag);
+      return static_cast<const EventAssnIndex<L, R>&>(*index);
+    }
+
+  private:
+    typedef std::tuple<std::string, std::type_index, std::type_index> Key;
+
+    const art::Event& fEvt;
+    std::map<Key, std::unique_ptr<EventAssnIndexBase>> fIndices;
+  };
+}
+
+#endif
@@ -5,8 +5,12 @@
 //////////////////////////////////////////////////////////////////////
 
 #include "FillReco.h"
+#include "CaloPointOrder.h"
 #include "RecoUtils/RecoUtils.h"
 
+#include <algorithm>
+#include <functional>
+
 namespace caf
 {
 
@@ -489,8 +493,12 @@ namespace caf
     }
   }
 
+  size_t HitKey(const art::Ptr<recob::Hit> &hit) {
+    return hit.key();
+  }
+
   void FillTrackPlaneCalo(const anab::Calorimetry &calo, 
-        const std::vector<art::Ptr<recob::Hit>> &hits,
+        const std::vector<art::Ptr<recob::Hit>> &hits_by_key,
         bool fill_calo_points, float fillhit_rrstart, float fillhit_rrend, 
         const detinfo::DetectorPropertiesData &dprop,
         caf::SRTrackCalo &srcalo) {
@@ -507,47 +515,40 @@ namespace caf
     srcalo.ke = 0.;
     srcalo.nhit = 0;
 
-    float rrmax = !rr.empty() ? *std::max_element(rr.begin(), rr.end()) : 0.;
-
     for (unsigned i = 0; i < dedx.size(); i++) {
-      // Save the points we need to
-      if (fill_calo_points && (
-          (rrmax - rr[i]) < fillhit_rrstart || // near start
-          rr[i] < fillhit_rrend)) { // near end
-
-        // Point information
-        caf::SRCaloPoint p;
-        p.rr = rr[i];
-        p.dqdx = dqdx[i];
-        p.dedx = dedx[i];
-        p.pitch = pitch[i];
-        p.t = dprop.ConvertXToTicks(xyz[i].x(), calo.PlaneID());
-
-        // lookup the wire -- the Calorimery object makes this
-        // __way__ harder than it should be
-        for (const art::Ptr<recob::Hit> &h: hits) {
-          if (h.key() == tps[i]) {
-            p.wire = h->WireID().Wire;
-            p.sumadc = h->SummedADC();
-            p.integral = h->Integral();
-          }
-        }
-
-        // Save
-        srcalo.points.push_back(p);
-      }
-
       if (dedx[i] > 1000.) continue;
       srcalo.nhit ++;
       srcalo.charge += dqdx[i] * pitch[i]; // ADC
       srcalo.ke += dedx[i] * pitch[i];
     }
 
-    // Sort the points by residual range hi->lo
-    std::sort(srcalo.points.begin(), srcalo.points.end(),
-      [](const caf::SRCaloPoint &lhs, const caf::SRCaloPoint &rhs) {
-        return lhs.rr > rhs.rr;
-    });
+    if (!fill_calo_points) return;
+
+    const std::vector<unsigned> order = CaloPointOrder(rr, fillhit_rrstart, fillhit_rrend);
+    srcalo.points.reserve(order.size());
+
+    for (unsigned i: order) {
+      // Point information
+      caf::SRCaloPoint p;
+      p.rr = rr[i];
+      p.dqdx = dqdx[i];
+      p.dedx = dedx[i];
+      p.pitch = pitch[i];
+      p.t = dprop.ConvertXToTicks(xyz[i].x(), calo.PlaneID());
+
+      // lookup the wire -- the Calorimery object makes this
+      // __way__ harder than it should be. If several hits have the key,
+      // the last one is used.
+      const art::Ptr<recob::Hit> *h = FindLastWithKey(hits_by_key, tps[i], HitKey);
+      if (h) {
+        p.wire = (*h)->WireID().Wire;
+        p.sumadc = (*h)->SummedADC();
+        p.integral = (*h)->Integral();
+      }
+
+      // Save
+      srcalo.points.push_back(p);
+    }
 
   }
 
@@ -593,12 +594,20 @@ namespace caf
     // ignore any charge with a deposition > 1000 MeV/cm
     // TODO: ignore first and last hit???
     //    assert(calos.size() == 0 || calos == 3);
+
+    // Index the hits by key once for all of the planes
+    std::vector<art::Ptr<recob::Hit>> hits_by_key;
+    if (fill_calo_points) {
+      hits_by_key = hits;
+      SortByKey(hits_by_key, HitKey);
+    }
+
     for (unsigned i = 0; i < calos.size(); i++) {
       const anab::Calorimetry &calo = *calos[i];
       if (calo.PlaneID()) {
         unsigned plane_id = calo.PlaneID().Plane;
         assert(plane_id < 3);
-        FillTrackPlaneCalo(calo, hits, fill_calo_points, fillhit_rrstart, fillhit_rrend, dprop, srtrack.calo[plane_id]);
+        FillTrackPlaneCalo(calo, hits_by_key, fill_calo_points, fillhit_rrstart, fillhit_rrend, dprop, srtrack.calo[plane_id]);
       }
     }
 
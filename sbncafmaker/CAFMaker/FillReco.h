@@ -126,8 +126,9 @@ namespace caf
                         caf::SRTrack& srtrack,
                         bool allowEmpty = false);
 
+  /// \a hits_by_key are the hits of the track, stably sorted by key
   void FillTrackPlaneCalo(const anab::Calorimetry &calo, 
-                     const std::vector<art::Ptr<recob::Hit>> &hits,
+                     const std::vector<art::Ptr<recob::Hit>> &hits_by_key,
                      bool fill_calo_points, float fillhit_rrstart, float fillhit_rrend, 
                      const detinfo::DetectorPropertiesData &dprop,
                      caf::SRTrackCalo &srcalo);
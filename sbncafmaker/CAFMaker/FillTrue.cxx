@@ -1,27 +1,31 @@
 #include "FillTrue.h"
 
-#include "larcorealg/GeoAlgo/GeoAlgo.h"
 #include "RecoUtils/RecoUtils.h"
+#include "G4ProcessTable.h"
+#include "NuVertexWindow.h"
+#include "TrajectoryContainment.h"
 
 #include <functional>
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
 
 // helper function declarations
 
-caf::SRTrackTruth MatchTrack2Truth(const detinfo::DetectorClocksData &clockData, const std::vector<caf::SRTrueParticle> &particles, const std::vector<art::Ptr<recob::Hit>> &hits,
-				   const std::map<int, caf::HitsEnergy> &all_hits_map);
+caf::SRTrackTruth MatchTrack2Truth(const CAFRecoUtils::HitTruthCache &hit_truth, const std::vector<caf::SRTrueParticle> &particles, const std::vector<art::Ptr<recob::Hit>> &hits,
+				   const caf::TrackIDMap<caf::HitsEnergy> &all_hits_map, bool validate);
 
-caf::SRTruthMatch MatchSlice2Truth(const std::vector<art::Ptr<recob::Hit>> &hits,
-                                   const std::vector<art::Ptr<simb::MCTruth>> &neutrinos,
-                                   const caf::SRTruthBranch &srtruth,
-                                   const cheat::ParticleInventoryService &inventory_service,
-                                   const detinfo::DetectorClocksData &clockData);
+caf::SRTrackTruth MatchTrack2TruthReference(const CAFRecoUtils::HitTruthCache &hit_truth, const std::vector<caf::SRTrueParticle> &particles, const std::vector<art::Ptr<recob::Hit>> &hits,
+                                            const caf::TrackIDMap<caf::HitsEnergy> &all_hits_map);
 
 float ContainedLength(const TVector3 &v0, const TVector3 &v1,
-                      const std::vector<geoalgo::AABox> &boxes);
+                      const std::vector<geo::BoxBoundedGeo> &boxes);
 
 bool FRFillNumuCC(const simb::MCTruth &mctruth,
                   const std::vector<art::Ptr<sim::MCTrack>> &mctracks,
+                  const std::vector<unsigned> &vertex_tracks,
                   const std::vector<geo::BoxBoundedGeo> &volumes,
                   TRandom &rand,
                   caf::SRFakeReco &fakereco);
@@ -29,27 +33,89 @@ bool FRFillNumuCC(const simb::MCTruth &mctruth,
 // helper function definitions
 
 bool isFromNuVertex(const simb::MCTruth& mc, const sim::MCTrack& track,
-                    float distance=5.0) {
+                    float distance=caf::kNuVertexDistance) {
   TVector3 nuVtx = mc.GetNeutrino().Nu().Trajectory().Position(0).Vect();
   TVector3 trkStart = track.Start().Position().Vect();
   return (trkStart - nuVtx).Mag() < distance;
 }
 
+namespace {
+  // PDG codes whose masses are looked up on every event: fake reco
+  // particles and neutrino parents. Sorted so that they can be binary
+  // searched.
+  constexpr int kPDGMassCodes[] = {
+    -3222, -3122, -3112, -2212, -2112, -321, -311, -211,
+    -16, -15, -14, -13, -12, -11,
+    11, 12, 13, 14, 15, 16, 22,
+    111, 130, 211, 221, 310, 311, 321,
+    2112, 2212, 3112, 3122, 3222,
+  };
+
+  constexpr bool PDGMassCodesSorted() {
+    for (size_t i = 1; i < std::size(kPDGMassCodes); i++) {
+      if (!(kPDGMassCodes[i-1] < kPDGMassCodes[i])) return false;
+    }
+    return true;
+  }
+  static_assert(PDGMassCodesSorted(), "kPDGMassCodes must be sorted, without duplicates");
+
+  // Index of \a pdg in kPDGMassCodes, or -1
+  constexpr int PDGMassIndex(int pdg) {
+    size_t lo = 0, hi = std::size(kPDGMassCodes);
+    while (lo < hi) {
+      const size_t mid = (lo + hi) / 2;
+      if (kPDGMassCodes[mid] < pdg) lo = mid + 1;
+      else hi = mid;
+    }
+    return (lo < std::size(kPDGMassCodes) && kPDGMassCodes[lo] == pdg) ? lo : -1;
+  }
+
+  // Mass in GeV from TDatabasePDG, or -1 if it doesn't know the particle
+  double DatabasePDGMass(int pdg) {
+    const TParticlePDG* ple = TDatabasePDG::Instance()->GetParticle(pdg);
+    if (ple == NULL) return -1;
+    return ple->Mass();
+  }
+
+  // Masses of kPDGMassCodes in GeV, taken from TDatabasePDG once so that
+  // they are exactly the values it returns. Every code must be known to
+  // it: a -1 in here would end up in the ion masses.
+  const std::array<double, std::size(kPDGMassCodes)> &PDGMassTable() {
+    static const std::array<double, std::size(kPDGMassCodes)> table = [] {
+      std::array<double, std::size(kPDGMassCodes)> ret;
+      for (size_t i = 0; i < ret.size(); i++) {
+        ret[i] = DatabasePDGMass(kPDGMassCodes[i]);
+        if (ret[i] < 0) {
+          std::cout << "CAFMaker: PDG code " << kPDGMassCodes[i]
+                    << " is not in TDatabasePDG. Remove it from kPDGMassCodes." << std::endl;
+          abort();
+        }
+      }
+      return ret;
+    }();
+    return table;
+  }
+}
+
 // returns particle mass in MeV
 double PDGMass(int pdg) {
-  const TDatabasePDG *PDGTable = TDatabasePDG::Instance();
   // regular particle
   if (pdg < 1000000000) {
-    TParticlePDG* ple = PDGTable->GetParticle(pdg);
-    if (ple == NULL) return -1;
-    return ple->Mass() * 1000.0;
+    const int index = PDGMassIndex(pdg);
+    const double mass = (index >= 0) ? PDGMassTable()[index] : DatabasePDGMass(pdg);
+    if (mass < 0) return -1;
+    return mass * 1000.0;
   }
   // ion
   else {
+    constexpr int proton = PDGMassIndex(2212);
+    constexpr int neutron = PDGMassIndex(2112);
+    static_assert(proton >= 0 && neutron >= 0, "kPDGMassCodes must hold the nucleons");
+
     int p = (pdg % 10000000) / 10000;
     int n = (pdg % 10000) / 10 - p;
-    return (PDGTable->GetParticle(2212)->Mass() * p +
-            PDGTable->GetParticle(2112)->Mass() * n) * 1000.0;
+    return (PDGMassTable()[proton] * p +
+            PDGMassTable()[neutron] * n) * 1000.0;
   }
 }
 
@@ -60,6 +126,44 @@ void CopyTMatrixDToVector(const TMatrixD& m, std::vector<float>& v)
   v.insert(v.end(), &start, &start + m.GetNoElements());
 }
 
+namespace {
+  /// Counts the distinct hit keys on each cryostat and plane, with one
+  /// bitmap over the keys per plane. Clear() only resets the words that
+  /// were set, so the counter is cheap to reuse between interactions.
+  class PlaneHitCounter {
+  public:
+    void Add(const art::Ptr<recob::Hit> &h) {
+      const geo::WireID &w = h->WireID();
+      if (w.Cryostat >= 2 || w.Plane >= 3) return;
+      std::vector<uint64_t> &bits = fBits[w.Cryostat][w.Plane];
+      const size_t word = h.key() / 64;
+      const uint64_t bit = uint64_t(1) << (h.key() % 64);
+      if (word >= bits.size()) bits.resize(word + 1, 0);
+      if (bits[word] & bit) return;
+      if (!bits[word]) fTouched[w.Cryostat][w.Plane].push_back(word);
+      bits[word] |= bit;
+      fCount[w.Cryostat][w.Plane]++;
+    }
+
+    unsigned Count(unsigned cryo, unsigned plane) const { return fCount[cryo][plane]; }
+
+    void Clear() {
+      for (unsigned c = 0; c < 2; c++) {
+        for (unsigned p = 0; p < 3; p++) {
+          for (size_t word: fTouched[c][p]) fBits[c][p][word] = 0;
+          fTouched[c][p].clear();
+          fCount[c][p] = 0;
+        }
+      }
+    }
+
+  private:
+    std::vector<uint64_t> fBits[2][3];
+    std::vector<size_t> fTouched[2][3];
+    unsigned fCount[2][3] = {};
+  };
+}
+
 namespace caf {
 
   //------------------------------------------------
@@ -94,14 +198,15 @@ namespace caf {
   //------------------------------------------------
 
   void FillTrackTruth(const std::vector<art::Ptr<recob::Hit>> &hits,
-                      const std::map<int, caf::HitsEnergy> &id_hits_map,
+                      const caf::TrackIDMap<caf::HitsEnergy> &id_hits_map,
                       const std::vector<caf::SRTrueParticle> &particles,
-                      const detinfo::DetectorClocksData &clockData,
+                      const CAFRecoUtils::HitTruthCache &hit_truth,
                       caf::SRTrack& srtrack,
-                      bool allowEmpty)
+                      bool allowEmpty,
+                      bool validate)
   {
     // Truth matching
-    srtrack.truth = MatchTrack2Truth(clockData, particles, hits, id_hits_map);
+    srtrack.truth = MatchTrack2Truth(hit_truth, particles, hits, id_hits_map, validate);
 
   }//FillTrackTruth
 
@@ -110,42 +215,37 @@ namespace caf {
   // TODO: write trith matching for shower. Currently uses track truth matching
   // N.B. this will only work if showers are rolled up
   void FillShowerTruth(const std::vector<art::Ptr<recob::Hit>> &hits,
-                       const std::map<int, caf::HitsEnergy> &id_hits_map,
+                       const caf::TrackIDMap<caf::HitsEnergy> &id_hits_map,
                        const std::vector<caf::SRTrueParticle> &particles,
-                       const detinfo::DetectorClocksData &clockData,
+                       const CAFRecoUtils::HitTruthCache &hit_truth,
                        caf::SRShower& srshower,
-                       bool allowEmpty)
+                       bool allowEmpty,
+                       bool validate)
   {
     // Truth matching
-    srshower.truth = MatchTrack2Truth(clockData, particles, hits, id_hits_map);
+    srshower.truth = MatchTrack2Truth(hit_truth, particles, hits, id_hits_map, validate);
 
   }//FillShowerTruth
 
 
   void FillStubTruth(const std::vector<art::Ptr<recob::Hit>> &hits,
-                     const std::map<int, caf::HitsEnergy> &id_hits_map,
+                     const caf::TrackIDMap<caf::HitsEnergy> &id_hits_map,
                      const std::vector<caf::SRTrueParticle> &particles,
-                     const detinfo::DetectorClocksData &clockData,
+                     const CAFRecoUtils::HitTruthCache &hit_truth,
                      caf::SRStub& srstub,
-                     bool allowEmpty) 
+                     bool allowEmpty,
+                     bool validate)
   {
-    srstub.truth = MatchTrack2Truth(clockData, particles, hits, id_hits_map);
+    srstub.truth = MatchTrack2Truth(hit_truth, particles, hits, id_hits_map, validate);
   }
 
 
   //------------------------------------------------
 
-  void FillSliceTruth(const std::vector<art::Ptr<recob::Hit>> &hits,
-                      const std::vector<art::Ptr<simb::MCTruth>> &neutrinos,
+  void FillSliceTruth(const caf::SRTruthMatch &tmatch,
                       const caf::SRTruthBranch &srmc,
-                      const cheat::ParticleInventoryService &inventory_service,
-                      const detinfo::DetectorClocksData &clockData,
-                      caf::SRSlice &srslice, 
-                      bool allowEmpty)
+                      caf::SRSlice &srslice)
   {
-
-    caf::SRTruthMatch tmatch = MatchSlice2Truth(hits, neutrinos, srmc, inventory_service, clockData);
-
     if (tmatch.index >= 0) {
       srslice.truth = srmc.nu[tmatch.index];
       srslice.tmatch = tmatch;
@@ -210,17 +310,14 @@ namespace caf {
    }
  }
 
- void FillSliceFakeReco(const std::vector<art::Ptr<recob::Hit>> &hits,
+ void FillSliceFakeReco(const caf::SRTruthMatch &tmatch,
                          const std::vector<art::Ptr<simb::MCTruth>> &neutrinos,
-                         const caf::SRTruthBranch &srmc,
-                         const cheat::ParticleInventoryService &inventory_service,
-                         const detinfo::DetectorClocksData &clockData,
                          caf::SRSlice &srslice,
                          const std::vector<art::Ptr<sim::MCTrack>> &mctracks,
+                         const std::vector<std::vector<unsigned>> &vertex_tracks,
                          const std::vector<geo::BoxBoundedGeo> &volumes, TRandom &rand)
   {
-    caf::SRTruthMatch tmatch = MatchSlice2Truth(hits, neutrinos, srmc, inventory_service, clockData);
-    if(tmatch.index >= 0) FRFillNumuCC(*neutrinos[tmatch.index], mctracks, volumes, rand, srslice.fake_reco);
+    if(tmatch.index >= 0) FRFillNumuCC(*neutrinos[tmatch.index], mctracks, vertex_tracks[tmatch.index], volumes, rand, srslice.fake_reco);
   }//FillSliceFakeReco
 
 
@@ -229,7 +326,8 @@ namespace caf {
       const simb::MCFlux &mcflux,
       const simb::GTruth& gtruth,
       const std::vector<caf::SRTrueParticle> &srparticles,
-      const std::map<int, std::vector<art::Ptr<recob::Hit>>> &id_to_truehit_map,
+      const std::vector<unsigned> &interaction_particles,
+      const caf::TrackIDMap<art::Ptr<recob::Hit>> &id_to_truehit_map,
       caf::SRTrueInteraction &srneutrino, size_t i,
       const std::vector<geo::BoxBoundedGeo> &active_volumes) {
 
@@ -246,62 +344,38 @@ namespace caf {
       }
     }
 
-    for(const caf::SRTrueParticle& part: srparticles){
-      // save the G4 particles that came from this interaction
-      if(part.interaction_id == (int)i) {
-        if(part.start_process == caf::kG4primary) srneutrino.prim.push_back(part);
+    // Distinct hits per-plane of the primary and of all particles
+    static thread_local PlaneHitCounter prim_hits, all_hits;
+    prim_hits.Clear();
+    all_hits.Clear();
 
-        // total up the deposited energy
-        for(int p = 0; p < 3; ++p) { 
-          for (int i_cryo = 0; i_cryo < 2; i_cryo++) {
-            srneutrino.plane[i_cryo][p].visE += part.plane[i_cryo][p].visE;
-          }
-        }
-      }
-    }
-    srneutrino.nprim = srneutrino.prim.size();
+    // The G4 particles that came from this interaction
+    for (unsigned i_part: interaction_particles) {
+      const caf::SRTrueParticle& part = srparticles[i_part];
+      const bool is_primary = part.start_process == caf::kG4primary;
 
-    // Set of hits per-plane: primary particles
-    {
-      std::vector<std::array<std::set<unsigned>, 3>> planehitIDs(2);
-      for (unsigned i_part = 0; i_part < srparticles.size(); i_part++) {
-        if (srparticles[i_part].start_process == caf::kG4primary && srparticles[i_part].interaction_id == (int)i) {
-          int track_id = srparticles[i_part].G4ID;
-          // Look for hits
-          if (!id_to_truehit_map.count(track_id)) continue;
-          for (const art::Ptr<recob::Hit> &h: id_to_truehit_map.at(track_id)) {
-            if (!h->WireID()) continue;
-            planehitIDs[h->WireID().Cryostat][h->WireID().Plane].insert(h.key());
-          }
-        }
-      }
+      if(is_primary) srneutrino.prim.push_back(part);
 
-      for(int p = 0; p < 3; ++p) {
+      // total up the deposited energy
+      for(int p = 0; p < 3; ++p) { 
         for (int i_cryo = 0; i_cryo < 2; i_cryo++) {
-          srneutrino.plane[i_cryo][p].nhitprim = planehitIDs[i_cryo][p].size();
+          srneutrino.plane[i_cryo][p].visE += part.plane[i_cryo][p].visE;
         }
       }
-    }
 
-    // Set of hits per-plane: all particles
-    {
-      std::vector<std::array<std::set<unsigned>, 3>> planehitIDs(2);
-      for (unsigned i_part = 0; i_part < srparticles.size(); i_part++) {
-        if (srparticles[i_part].interaction_id == (int)i) {
-          int track_id = srparticles[i_part].G4ID;
-          // Look for hits
-          if (!id_to_truehit_map.count(track_id)) continue;
-          for (const art::Ptr<recob::Hit> &h: id_to_truehit_map.at(track_id)) {
-            if (!h->WireID()) continue;
-            planehitIDs[h->WireID().Cryostat][h->WireID().Plane].insert(h.key());
-          }
-        }
+      // Look for hits
+      for (const art::Ptr<recob::Hit> &h: id_to_truehit_map.at(part.G4ID)) {
+        if (!h->WireID()) continue;
+        all_hits.Add(h);
+        if (is_primary) prim_hits.Add(h);
       }
+    }
+    srneutrino.nprim = srneutrino.prim.size();
 
-      for(int p = 0; p < 3; ++p) {
-        for (int i_cryo = 0; i_cryo < 2; i_cryo++) {
-          srneutrino.plane[i_cryo][p].nhit = planehitIDs[i_cryo][p].size();
-        }
+    for(int p = 0; p < 3; ++p) {
+      for (int i_cryo = 0; i_cryo < 2; i_cryo++) {
+        srneutrino.plane[i_cryo][p].nhitprim = prim_hits.Count(i_cryo, p);
+        srneutrino.plane[i_cryo][p].nhit = all_hits.Count(i_cryo, p);
       }
     }
 
@@ -404,18 +478,14 @@ namespace caf {
   void FillTrueG4Particle(const simb::MCParticle &particle,
         const std::vector<geo::BoxBoundedGeo> &active_volumes,
         const std::vector<std::vector<geo::BoxBoundedGeo>> &tpc_volumes,
-        const std::map<int, std::vector<std::pair<geo::WireID, const sim::IDE *>>> &id_to_ide_map,
-        const std::map<int, std::vector<art::Ptr<recob::Hit>>> &id_to_truehit_map,
-        const cheat::BackTrackerService &backtracker,
-        const cheat::ParticleInventoryService &inventory_service,
-        const std::vector<art::Ptr<simb::MCTruth>> &neutrinos,
+        const caf::TrackIDMap<std::pair<geo::WireID, const sim::IDE*>> &id_to_ide_map,
+        const caf::TrackIDMap<art::Ptr<recob::Hit>> &id_to_truehit_map,
+        int interaction_id,
                           caf::SRTrueParticle &srparticle) {
 
-    std::vector<std::pair<geo::WireID, const sim::IDE *>> empty;
-    const std::vector<std::pair<geo::WireID, const sim::IDE *>> &particle_ides = id_to_ide_map.count(particle.TrackId()) ? id_to_ide_map.at(particle.TrackId()) : empty;
-
-    std::vector<art::Ptr<recob::Hit>> emptyHits;
-    const std::vector<art::Ptr<recob::Hit>> &particle_hits = id_to_truehit_map.count(particle.TrackId()) ? id_to_truehit_map.at(particle.TrackId()) : emptyHits;
+    // Empty if the particle has no IDEs / hits
+    const auto particle_ides = id_to_ide_map.at(particle.TrackId());
+    const auto particle_hits = id_to_truehit_map.at(particle.TrackId());
 
     srparticle.length = 0.;
     srparticle.crosses_tpc = false;
@@ -449,104 +519,21 @@ namespace caf {
       }
     } 
 
-    // if no trajectory points, then assume outside AV
-    srparticle.cont_tpc = particle.NumberTrajectoryPoints() > 0;
-    srparticle.contained = particle.NumberTrajectoryPoints() > 0;
+    // Get the entry and exit points, containment and contained length
+    const TrajectoryContainment containment = ComputeTrajectoryContainment(particle.Trajectory(), active_volumes, tpc_volumes);
+    const int entry_point = containment.entry_point;
+    const int exit_point = containment.exit_point;
+    const int cryostat_index = containment.cryostat_index;
 
-    // Get the entry and exit points
-    int entry_point = -1;
+    srparticle.contained = containment.contained;
+    srparticle.cont_tpc = containment.cont_tpc;
+    srparticle.crosses_tpc = containment.crosses_tpc;
+    srparticle.length = containment.length;
 
-    int cryostat_index = -1;
-    int tpc_index = -1;
-
-    for (unsigned j = 0; j < particle.NumberTrajectoryPoints(); j++) {
-      for (unsigned i = 0; i < active_volumes.size(); i++) {
-        if (active_volumes.at(i).ContainsPosition(particle.Position(j).Vect())) {
-          entry_point = j;
-          cryostat_index = i;
-          break;
-        }
-      }
-      if (entry_point != -1) break;
-    }
     // get the wall
     if (entry_point > 0) {
       srparticle.wallin = GetWallCross(active_volumes.at(cryostat_index), particle.Position(entry_point).Vect(), particle.Position(entry_point-1).Vect());
     }
-
-    int exit_point = -1;
-
-    // now setup the cryostat the particle is in
-    std::vector<geo::BoxBoundedGeo> volumes;
-    if (entry_point >= 0) {
-      volumes = tpc_volumes.at(cryostat_index);
-      for (unsigned i = 0; i < volumes.size(); i++) {
-        if (volumes[i].ContainsPosition(particle.Position(entry_point).Vect())) {
-          tpc_index = i;
-          srparticle.cont_tpc = entry_point == 0;
-          break;
-        }
-      }
-      srparticle.contained = entry_point == 0;
-    }
-    // if we couldn't find the initial point, set not contained
-    else {
-      srparticle.contained = false;
-    }
-    if (tpc_index < 0) {
-      srparticle.cont_tpc = false;
-    }
-
-    // setup aa volumes too for length calc
-    // Define the volume used for length calculation to be the cryostat volume in question
-    std::vector<geoalgo::AABox> aa_volumes;
-    if (entry_point >= 0) {
-      const geo::BoxBoundedGeo &v = active_volumes.at(cryostat_index);
-      aa_volumes.emplace_back(v.MinX(), v.MinY(), v.MinZ(), v.MaxX(), v.MaxY(), v.MaxZ());
-    }
-
-    // Get the length and determine if any point leaves the active volume
-    //
-    // Use every trajectory point if possible
-    if (entry_point >= 0) {
-      // particle trajectory
-      const simb::MCTrajectory &trajectory = particle.Trajectory();
-      TVector3 pos = trajectory.Position(entry_point).Vect();
-      for (unsigned i = entry_point+1; i < particle.NumberTrajectoryPoints(); i++) {
-        TVector3 this_point = trajectory.Position(i).Vect();
-        // get the exit point
-        // update if particle is contained
-        // check if particle has crossed TPC
-        if (!srparticle.crosses_tpc) {
-          for (unsigned j = 0; j < volumes.size(); j++) {
-            if (volumes[j].ContainsPosition(this_point) && tpc_index >= 0 && j != ((unsigned)tpc_index)) {
-              srparticle.crosses_tpc = true;
-              break;
-            }
-          }
-        }
-        // check if particle has left tpc
-        if (srparticle.cont_tpc) {
-          srparticle.cont_tpc = volumes[tpc_index].ContainsPosition(this_point);
-        }
-
-        if (srparticle.contained) {
-          srparticle.contained = active_volumes.at(cryostat_index).ContainsPosition(this_point);
-        }
-
-        // update length
-        srparticle.length += ContainedLength(this_point, pos, aa_volumes);
-
-        if (!active_volumes.at(cryostat_index).ContainsPosition(this_point) && active_volumes.at(cryostat_index).ContainsPosition(pos)) {
-          exit_point = i-1;
-        }
-
-        pos = trajectory.Position(i).Vect();
-      }
-    }
-    if (exit_point < 0 && entry_point >= 0) {
-      exit_point = particle.NumberTrajectoryPoints() - 1;
-    }
     if (exit_point >= 0 && ((unsigned)exit_point) < particle.NumberTrajectoryPoints() - 1) {
       srparticle.wallout = GetWallCross(active_volumes.at(cryostat_index), particle.Position(exit_point).Vect(), particle.Position(exit_point+1).Vect());
     }
@@ -576,43 +563,28 @@ namespace caf {
     srparticle.parent = particle.Mother();
 
     // Set the initial cryostat
-    srparticle.cryostat = -1;
-    if (entry_point >= 0) {
-      for (unsigned c = 0; c < active_volumes.size(); c++) {
-        if (active_volumes[c].ContainsPosition(particle.Position(entry_point).Vect())) {
-          srparticle.cryostat = c;
-          break;
-        }
-      }
-    }
+    srparticle.cryostat = cryostat_index;
 
     // Save the daughter particles
     for (int i_d = 0; i_d < particle.NumberDaughters(); i_d++) {
       srparticle.daughters.push_back(particle.Daughter(i_d));
     }
 
-    // See if this MCParticle matches a genie truth
-    srparticle.interaction_id = -1;
-
-    art::Ptr<simb::MCTruth> truth = inventory_service.TrackIdToMCTruth_P(particle.TrackId());
-    for (unsigned i = 0; i < neutrinos.size(); i++) {
-      if (truth.get() == neutrinos[i].get()) {
-        srparticle.interaction_id = i;
-        break;
-      }
-    }
+    // Which genie truth this MCParticle matches, if any
+    srparticle.interaction_id = interaction_id;
   } //FillTrueG4Particle
 
   void FillFakeReco(const std::vector<art::Ptr<simb::MCTruth>> &mctruths,
                     const std::vector<art::Ptr<sim::MCTrack>> &mctracks,
+                    const std::vector<std::vector<unsigned>> &vertex_tracks,
                     const std::vector<geo::BoxBoundedGeo> &volumes,
                     TRandom &rand,
                     std::vector<caf::SRFakeReco> &srfakereco) {
     // iterate and fill
-    for (const art::Ptr<simb::MCTruth> mctruth: mctruths) {
+    for (unsigned i = 0; i < mctruths.size(); i++) {
       bool do_fill = false;
       caf::SRFakeReco this_fakereco;
-      do_fill = FRFillNumuCC(*mctruth, mctracks, volumes, rand, this_fakereco);
+      do_fill = FRFillNumuCC(*mctruths[i], mctracks, vertex_tracks[i], volumes, rand, this_fakereco);
 
       // TODO: others?
       // if (!do_fill) ...
@@ -621,36 +593,69 @@ namespace caf {
     }
   }
 
-  std::map<int, caf::HitsEnergy> SetupIDHitEnergyMap(const std::vector<art::Ptr<recob::Hit>> &allHits,
-                                                           const detinfo::DetectorClocksData &clockData, 
-                                                           const cheat::BackTrackerService &backtracker) {
-    std::map<int, caf::HitsEnergy> ret;
+  std::vector<std::vector<unsigned>> PrepFakeRecoTracks(const std::vector<art::Ptr<simb::MCTruth>> &mctruths,
+                                                        const std::vector<art::Ptr<sim::MCTrack>> &mctracks) {
+    std::vector<std::vector<unsigned>> ret(mctruths.size());
 
-    for (const art::Ptr<recob::Hit> h : allHits) {
-      const int hit_trackID = CAFRecoUtils::GetShowerPrimary(TruthMatchUtils::TrueParticleID(clockData, h, true));
-      ++ret[hit_trackID].nHits;
+    // Neutrino vertices sorted in z, so that each track is only compared
+    // with the vertices closer than the isFromNuVertex distance in z
+    VertexZList vertices;
+    for (unsigned i = 0; i < mctruths.size(); i++) {
+      if (!mctruths[i]->NeutrinoSet()) continue;
+      vertices.push_back({mctruths[i]->GetNeutrino().Nu().Trajectory().Position(0).Z(), i});
+    }
+    if (vertices.empty()) return ret;
+    std::sort(vertices.begin(), vertices.end());
+
+    for (unsigned i_trk = 0; i_trk < mctracks.size(); i_trk++) {
+      const sim::MCTrack &track = *mctracks[i_trk];
+      if (track.Process() != "primary") continue;
 
-      for (const sim::TrackIDE ide : backtracker.HitToTrackIDEs(clockData, h)) {
-        const int ide_trackID = CAFRecoUtils::GetShowerPrimary(ide.trackID);
-        ret[ide_trackID].totE += ide.energy;
+      const auto near = VerticesNearZ(vertices, track.Start().Position().Z(), kNuVertexDistance);
+      for (auto it = near.first; it != near.second; ++it) {
+        if (isFromNuVertex(*mctruths[it->second], track, kNuVertexDistance)) ret[it->second].push_back(i_trk);
       }
     }
+
     return ret;
   }
 
-  std::map<int, std::vector<art::Ptr<recob::Hit>>> PrepTrueHits(const std::vector<art::Ptr<recob::Hit>> &allHits, 
-    const detinfo::DetectorClocksData &clockData, const cheat::BackTrackerService &backtracker) {
-    std::map<int, std::vector<art::Ptr<recob::Hit>>> ret;
-    for (const art::Ptr<recob::Hit> h: allHits) {
-      for (int ID: backtracker.HitToTrackIds(clockData, *h)) {
-        ret[abs(ID)].push_back(h);
+  caf::TrackIDMap<caf::HitsEnergy> SetupIDHitEnergyMap(const std::vector<art::Ptr<recob::Hit>> &allHits,
+                                                           const CAFRecoUtils::HitTruthCache &hit_truth) {
+    // Each hit contributes one hit to its leading ID and its energy to
+    // every ID, summed per ID in hit order
+    std::vector<std::pair<int, caf::HitsEnergy>> contributions;
+    contributions.reserve(2*allHits.size());
+
+    for (const art::Ptr<recob::Hit> &h : allHits) {
+      const int hit_trackID = hit_truth.ShowerPrimary(CAFRecoUtils::TrueParticleID(hit_truth, h, true));
+      contributions.push_back({hit_trackID, caf::HitsEnergy{1, 0.}});
+
+      for (const CAFRecoUtils::HitTrackIDE &ide : hit_truth.at(h)) {
+        const int ide_trackID = hit_truth.ShowerPrimary(ide.trackID);
+        contributions.push_back({ide_trackID, caf::HitsEnergy{0, ide.energy}});
       }
     }
-    return ret;
+
+    return caf::TrackIDMap<caf::HitsEnergy>(contributions).Combine(
+      [](const caf::HitsEnergy &a, const caf::HitsEnergy &b) {
+        return caf::HitsEnergy{a.nHits + b.nHits, a.totE + b.totE};
+      });
+  }
+
+  caf::TrackIDMap<art::Ptr<recob::Hit>> PrepTrueHits(const std::vector<art::Ptr<recob::Hit>> &allHits, 
+    const CAFRecoUtils::HitTruthCache &hit_truth) {
+    std::vector<std::pair<int, art::Ptr<recob::Hit>>> entries;
+    for (const art::Ptr<recob::Hit> &h: allHits) {
+      for (const CAFRecoUtils::HitTrackIDE &ide: hit_truth.at(h)) {
+        entries.emplace_back(abs(ide.trackID), h);
+      }
+    }
+    return caf::TrackIDMap<art::Ptr<recob::Hit>>(entries);
   }
 
-  std::map<int, std::vector<std::pair<geo::WireID, const sim::IDE*>>> PrepSimChannels(const std::vector<art::Ptr<sim::SimChannel>> &simchannels, const geo::GeometryCore &geo) {
-    std::map<int, std::vector<std::pair<geo::WireID, const sim::IDE*>>> ret;
+  caf::TrackIDMap<std::pair<geo::WireID, const sim::IDE*>> PrepSimChannels(const std::vector<art::Ptr<sim::SimChannel>> &simchannels, const geo::GeometryCore &geo) {
+    std::vector<std::pair<int, std::pair<geo::WireID, const sim::IDE*>>> entries;
 
     for (const art::Ptr<sim::SimChannel> sc : simchannels) {
       // Lookup the wire of this channel
@@ -661,12 +666,11 @@ namespace caf {
 
       for (const auto &item : sc->TDCIDEMap()) {
         for (const sim::IDE &ide: item.second) {
-          // indexing initializes empty vector
-          ret[abs(ide.trackID)].push_back({thisWire, &ide});
+          entries.push_back({abs(ide.trackID), {thisWire, &ide}});
         }
       }
     }
-    return ret;
+    return caf::TrackIDMap<std::pair<geo::WireID, const sim::IDE*>>(entries);
   }
 
 } // end namespace
@@ -676,6 +680,7 @@ namespace caf {
 
 bool FRFillNumuCC(const simb::MCTruth &mctruth,
                   const std::vector<art::Ptr<sim::MCTrack>> &mctracks,
+                  const std::vector<unsigned> &vertex_tracks,
                   const std::vector<geo::BoxBoundedGeo> &volumes,
                   TRandom &rand,
                   caf::SRFakeReco &fakereco) {
@@ -723,17 +728,15 @@ bool FRFillNumuCC(const simb::MCTruth &mctruth,
 
   if (cryo_index == -1) return false;
 
-  std::vector<geoalgo::AABox> aa_volumes;
-  const geo::BoxBoundedGeo &v = volumes.at(cryo_index);
-  aa_volumes.emplace_back(v.MinX(), v.MinY(), v.MinZ(), v.MaxX(), v.MaxY(), v.MaxZ());
+  const std::vector<geo::BoxBoundedGeo> aa_volumes {volumes.at(cryo_index)};
 
   // look for CC lepton or a \pi^+/- which can "fake" a numu CC interaction
 
   int lepton_ind = -1;
   // CC lepton
   if (abs(mctruth.GetNeutrino().Nu().PdgCode()) == 14 && mctruth.GetNeutrino().CCNC() == 0) {
-    for (int i = 0; i < (int)mctracks.size(); i++) {
-      if (isFromNuVertex(mctruth, *mctracks[i]) && abs(mctracks[i]->PdgCode()) == 13 && mctracks[i]->Process() == "primary") {
+    for (int i: vertex_tracks) {
+      if (abs(mctracks[i]->PdgCode()) == 13) {
         if (lepton_ind == -1 || mctracks[lepton_ind]->Start().E() < mctracks[i]->Start().E()) {
           lepton_ind = i;
         }
@@ -742,8 +745,8 @@ bool FRFillNumuCC(const simb::MCTruth &mctruth,
   }
   // NC pion
   else if (mctruth.GetNeutrino().CCNC() == 1) {
-    for (int i = 0; i < (int)mctracks.size(); i++) {
-      if (isFromNuVertex(mctruth, *mctracks[i]) && abs(mctracks[i]->PdgCode()) == 211 && mctracks[i]->Process() == "primary") {
+    for (int i: vertex_tracks) {
+      if (abs(mctracks[i]->PdgCode()) == 211) {
         if (lepton_ind == -1 || mctracks[lepton_ind]->Start().E() < mctracks[i]->Start().E()) {
           lepton_ind = i;
         }
@@ -781,10 +784,9 @@ bool FRFillNumuCC(const simb::MCTruth &mctruth,
   // get the hadronic state
   std::vector<caf::SRFakeRecoParticle> hadrons;
 
-  for (int i = 0; i < (int)mctracks.size(); i++) {
-    if (isFromNuVertex(mctruth, *mctracks[i]) // from this interaction
-     && (abs(mctracks[i]->PdgCode()) == 211 || abs(mctracks[i]->PdgCode()) == 321 || abs(mctracks[i]->PdgCode()) == 2212) // hadronic
-     && mctracks[i]->Process() == "primary" // primary
+  // primary tracks from this interaction
+  for (int i: vertex_tracks) {
+    if ((abs(mctracks[i]->PdgCode()) == 211 || abs(mctracks[i]->PdgCode()) == 321 || abs(mctracks[i]->PdgCode()) == 2212) // hadronic
      && i != lepton_ind // not the fake lepton
     ) {
       caf::SRFakeRecoParticle hadron;
@@ -880,217 +882,74 @@ caf::Wall_t caf::GetWallCross(const geo::BoxBoundedGeo &volume, const TVector3 p
 //------------------------------------------
 
 caf::g4_process_ caf::GetG4ProcessID(const std::string &process_name) {
-#define MATCH_PROCESS(name) if (process_name == #name) {return caf::kG4 ## name;}
-#define MATCH_PROCESS_NAMED(strname, id) if (process_name == #strname) {return caf::kG4 ## id;}
-  MATCH_PROCESS(primary)
-  MATCH_PROCESS(CoupledTransportation)
-  MATCH_PROCESS(FastScintillation)
-  MATCH_PROCESS(Decay)
-  MATCH_PROCESS(anti_neutronInelastic)
-  MATCH_PROCESS(neutronInelastic)
-  MATCH_PROCESS(anti_protonInelastic)
-  MATCH_PROCESS(protonInelastic)
-  MATCH_PROCESS(hadInelastic)
-  MATCH_PROCESS_NAMED(kaon+Inelastic, kaonpInelastic)
-  MATCH_PROCESS_NAMED(kaon-Inelastic, kaonmInelastic)
-  MATCH_PROCESS_NAMED(kaon+Inelastic, kaonpInelastic)
-  MATCH_PROCESS_NAMED(kaon-Inelastic, kaonmInelastic)
-  MATCH_PROCESS_NAMED(sigma+Inelastic, sigmapInelastic)
-  MATCH_PROCESS_NAMED(sigma-Inelastic, sigmamInelastic)
-  MATCH_PROCESS_NAMED(pi+Inelastic, pipInelastic)
-  MATCH_PROCESS_NAMED(pi-Inelastic, pimInelastic)
-  MATCH_PROCESS_NAMED(xi+Inelastic, xipInelastic)
-  MATCH_PROCESS_NAMED(xi-Inelastic, ximInelastic)
-  MATCH_PROCESS(kaon0LInelastic)
-  MATCH_PROCESS(kaon0SInelastic)
-  MATCH_PROCESS(lambdaInelastic)
-  MATCH_PROCESS_NAMED(anti-lambdaInelastic, anti_lambdaInelastic)
-  MATCH_PROCESS(He3Inelastic)
-  MATCH_PROCESS(ionInelastic)
-  MATCH_PROCESS(xi0Inelastic)
-  MATCH_PROCESS(alphaInelastic)
-  MATCH_PROCESS(tInelastic)
-  MATCH_PROCESS(dInelastic)
-  MATCH_PROCESS(anti_neutronElastic)
-  MATCH_PROCESS(neutronElastic)
-  MATCH_PROCESS(anti_protonElastic)
-  MATCH_PROCESS(protonElastic)
-  MATCH_PROCESS(hadElastic)
-  MATCH_PROCESS_NAMED(kaon+Elastic, kaonpElastic)
-  MATCH_PROCESS_NAMED(kaon-Elastic, kaonmElastic)
-  MATCH_PROCESS_NAMED(pi+Elastic, pipElastic)
-  MATCH_PROCESS_NAMED(pi-Elastic, pimElastic)
-  MATCH_PROCESS(conv)
-  MATCH_PROCESS(phot)
-  MATCH_PROCESS(annihil)
-  MATCH_PROCESS(nCapture)
-  MATCH_PROCESS(nKiller)
-  MATCH_PROCESS(muMinusCaptureAtRest)
-  MATCH_PROCESS(muIoni)
-  MATCH_PROCESS(eBrem)
-  MATCH_PROCESS(CoulombScat)
-  MATCH_PROCESS(hBertiniCaptureAtRest)
-  MATCH_PROCESS(hFritiofCaptureAtRest)
-  MATCH_PROCESS(photonNuclear)
-  MATCH_PROCESS(muonNuclear)
-  MATCH_PROCESS(electronNuclear)
-  MATCH_PROCESS(positronNuclear)
-  MATCH_PROCESS(compt)
-  MATCH_PROCESS(eIoni)
-  MATCH_PROCESS(muBrems)
-  MATCH_PROCESS(hIoni)
-  MATCH_PROCESS(ionIoni)
-  MATCH_PROCESS(hBrems)
-  MATCH_PROCESS(muPairProd)
-  MATCH_PROCESS(hPairProd)
-  MATCH_PROCESS(LArVoxelReadoutScoringProcess)
-  MATCH_PROCESS(Transportation)
-  MATCH_PROCESS(msc)
-  MATCH_PROCESS(StepLimiter)
-  std::cerr << "Error: Process name with no match (" << process_name << ")\n";
-  assert(false);
-  return caf::kG4UNKNOWN; // unreachable in debug mode
-#undef MATCH_PROCESS
-#undef MATCH_PROCESS_NAMED
-
+  const caf::g4_process_ id = caf::FindG4Process(process_name);
+  if (id == caf::kG4UNKNOWN) {
+    std::cerr << "Error: Process name with no match (" << process_name << ")\n";
+    assert(false);
+  }
+  return id;
 }//GetG4ProcessID
 //-------------------------------------------
 
 float ContainedLength(const TVector3 &v0, const TVector3 &v1,
-                       const std::vector<geoalgo::AABox> &boxes) {
-  static const geoalgo::GeoAlgo algo;
+                       const std::vector<geo::BoxBoundedGeo> &boxes) {
+  const double p0[3] = {v0.X(), v0.Y(), v0.Z()};
+  const double p1[3] = {v1.X(), v1.Y(), v1.Z()};
 
   // if points are the same, return 0
-  if ((v0 - v1).Mag() < 1e-6) return 0;
-
-  // construct individual points
-  geoalgo::Point_t p0(v0);
-  geoalgo::Point_t p1(v1);
-
-  // construct line segment
-  geoalgo::LineSegment line(p0, p1);
+  const double dx = p1[0] - p0[0], dy = p1[1] - p0[1], dz = p1[2] - p0[2];
+  if (std::sqrt(dx*dx + dy*dy + dz*dz) < 1e-6) return 0;
 
   double length = 0;
 
   // total contained length is sum of lengths in all boxes
   // assuming they are non-overlapping
   for (auto const &box: boxes) {
-    int n_contained = box.Contain(p0) + box.Contain(p1);
-    // both points contained -- length is total length (also can break out of loop)
-    if (n_contained == 2) {
-      length = (v1 - v0).Mag();
-      break;
-    }
-    // one contained -- have to find intersection point (which must exist)
-    if (n_contained == 1) {
-      auto intersections = algo.Intersection(line, box);
-      // Because of floating point errors, it can sometimes happen
-      // that there is 1 contained point but no "Intersections"
-      // if one of the points is right on the edge
-      if (intersections.size() == 0) {
-        // determine which point is on the edge
-        double tol = 1e-5;
-        bool p0_edge = algo.SqDist(p0, box) < tol;
-        bool p1_edge = algo.SqDist(p1, box) < tol;
-        assert(p0_edge || p1_edge);
-        // contained one is on edge -- can treat both as not contained
-        //
-        // In this case, no length
-        if ((p0_edge && box.Contain(p0)) || (box.Contain(p1) && p1_edge))
-          continue;
-        // un-contaned one is on edge -- treat both as contained
-        else if ((p0_edge && box.Contain(p1)) || (box.Contain(p0) && p1_edge)) {
-    length = (v1 - v0).Mag();
-    break;
-        }
-        else {
-          assert(false); // bad
-        }
-      }
-      // floating point errors can also falsely cause 2 intersection points
-      //
-      // in this case, one of the intersections must be very close to the
-      // "contained" point, so the total contained length will be about
-      // the same as the distance between the two intersection points
-      else if (intersections.size() == 2) {
-        length += (intersections.at(0).ToTLorentzVector().Vect() - intersections.at(1).ToTLorentzVector().Vect()).Mag();
-        continue;
-      }
-      // "Correct"/ideal case -- 1 intersection point
-      else if (intersections.size() == 1) {
-        // get TVector at intersection point
-        TVector3 int_tv(intersections.at(0).ToTLorentzVector().Vect());
-        length += ( box.Contain(p0) ? (v0 - int_tv).Mag() : (v1 - int_tv).Mag() );
-      }
-      else assert(false); // bad
-    }
-    // none contained -- either must have zero or two intersections
-    if (n_contained == 0) {
-      auto intersections = algo.Intersection(line, box);
-      if (!(intersections.size() == 0 || intersections.size() == 2)) {
-        // more floating point error fixes...
-        //
-        // figure out which points are near the edge
-        double tol = 1e-5;
-        bool p0_edge = algo.SqDist(p0, box) < tol;
-        bool p1_edge = algo.SqDist(p1, box) < tol;
-        // and which points are near the intersection
-        TVector3 vint = intersections.at(0).ToTLorentzVector().Vect();
-
-        bool p0_int = (v0 - vint).Mag() < tol;
-        bool p1_int = (v1 - vint).Mag() < tol;
-        // exactly one of them should produce the intersection
-        assert((p0_int && p0_edge) != (p1_int && p1_edge));
-        // void variables when assert-ions are turned off
-        (void) p0_int; (void) p1_int;
-
-        // both close to edge -- full length is contained
-        if (p0_edge && p1_edge) {
-          length += (v0 - v1).Mag();
-        }
-        // otherwise -- one of them is not on an edge, no length is contained
-        else {}
-      }
-      // assert(intersections.size() == 0 || intersections.size() == 2);
-      else if (intersections.size() == 2) {
-        TVector3 start(intersections.at(0).ToTLorentzVector().Vect());
-        TVector3 end(intersections.at(1).ToTLorentzVector().Vect());
-        length += (start - end).Mag();
-      }
-    }
+    const double lo[3] = {box.MinX(), box.MinY(), box.MinZ()};
+    const double hi[3] = {box.MaxX(), box.MaxY(), box.MaxZ()};
+    length += caf::ClippedSegmentLength(p0, p1, lo, hi);
   }
 
   return length;
 }//ContainedLength
 
 //------------------------------------------------
-caf::SRTrackTruth MatchTrack2Truth(const detinfo::DetectorClocksData &clockData, const std::vector<caf::SRTrueParticle> &particles, const std::vector<art::Ptr<recob::Hit>> &hits,
-				   const std::map<int, caf::HitsEnergy> &all_hits_map) {
-
-  art::ServiceHandle<cheat::BackTrackerService> bt_serv;
-
-  // this id is the same as the mcparticle ID as long as we got it from geant4
-  std::vector<std::pair<int, float>> matches = CAFRecoUtils::AllTrueParticleIDEnergyMatches(clockData, hits, true);
-  float total_energy = CAFRecoUtils::TotalHitEnergy(clockData, hits);
-  std::map<int, caf::HitsEnergy> track_hits_map = caf::SetupIDHitEnergyMap(hits, clockData, *bt_serv.get());
+// Per-ID sums over the hits of one reco object
+struct TrackIDMatch {
+  float energy = 0.; ///< Sum of the ID's IDE energies [MeV]
+  int nHits = 0;     ///< Number of hits where it is the leading ID
+  bool hasIDE = false;
+};
+
+// A missing entry in the map counts as no hits and no energy
+caf::HitsEnergy FindHitsEnergy(const caf::TrackIDMap<caf::HitsEnergy> &hits_map, int G4ID)
+{
+  const auto found = hits_map.at(G4ID);
+  if (found.empty()) return caf::HitsEnergy{0, 0.};
+  return found[0];
+}
 
+// Everything after the per-ID sums, shared by MatchTrack2Truth and
+// MatchTrack2TruthReference
+caf::SRTrackTruth FinishTrack2Truth(const std::vector<caf::SRTrueParticle> &particles, const std::vector<art::Ptr<recob::Hit>> &hits,
+                                    const caf::TrackIDMap<caf::HitsEnergy> &all_hits_map,
+                                    const std::vector<std::pair<int, TrackIDMatch>> &id_matches, float total_energy) {
   caf::SRTrackTruth ret;
 
   ret.visEintrk = total_energy / 1000. /* MeV -> GeV */;
 
   // setup the matches
-  for (auto const &pair: matches) {
+  for (auto const &pair: id_matches) {
     caf::SRParticleMatch match;
     match.G4ID = pair.first;
-    match.energy = pair.second / 1000. /* MeV -> GeV */;
+    match.energy = pair.second.energy / 1000. /* MeV -> GeV */;
 
-    caf::HitsEnergy track_matched_hits = track_hits_map.find(match.G4ID)->second;
-    caf::HitsEnergy all_matched_hits = all_hits_map.find(match.G4ID)->second;
+    caf::HitsEnergy all_matched_hits = FindHitsEnergy(all_hits_map, match.G4ID);
 
-    match.hit_purity = (hits.size() != 0) ? track_matched_hits.nHits / (float) hits.size() : 0.;
+    match.hit_purity = (hits.size() != 0) ? pair.second.nHits / (float) hits.size() : 0.;
     match.energy_purity = (ret.visEintrk > 0) ? match.energy / ret.visEintrk : 0.;
-    match.hit_completeness = (all_matched_hits.nHits != 0) ? track_matched_hits.nHits / (float) all_matched_hits.nHits : 0.;
-    match.energy_completeness = (all_matched_hits.totE > 0) ? pair.second / all_matched_hits.totE : 0.;
+    match.hit_completeness = (all_matched_hits.nHits != 0) ? pair.second.nHits / (float) all_matched_hits.nHits : 0.;
+    match.energy_completeness = (all_matched_hits.totE > 0) ? pair.second.energy / all_matched_hits.totE : 0.;
     
     ret.matches.push_back(match);
   }
@@ -1149,16 +1008,134 @@ caf::SRTrackTruth MatchTrack2Truth(const detinfo::DetectorClocksData &clockData,
 
   ret.nmatches = ret.matches.size();
 
+  return ret;
+}//FinishTrack2Truth
+
+// Bitwise equality, except that NaN matches NaN
+bool SameValue(float a, float b)
+{
+  return a == b || (std::isnan(a) && std::isnan(b));
+}
+
+bool SameMatch(const caf::SRParticleMatch &a, const caf::SRParticleMatch &b)
+{
+  return a.G4ID == b.G4ID && SameValue(a.energy, b.energy) &&
+    SameValue(a.hit_purity, b.hit_purity) && SameValue(a.energy_purity, b.energy_purity) &&
+    SameValue(a.hit_completeness, b.hit_completeness) && SameValue(a.energy_completeness, b.energy_completeness);
+}
+
+bool SameTrackTruth(const caf::SRTrackTruth &a, const caf::SRTrackTruth &b)
+{
+  if (a.nmatches != b.nmatches || a.matches.size() != b.matches.size()) return false;
+  for (unsigned i = 0; i < a.matches.size(); i++) {
+    if (!SameMatch(a.matches[i], b.matches[i])) return false;
+  }
+  return SameMatch(a.bestmatch, b.bestmatch) && a.p.G4ID == b.p.G4ID &&
+    SameValue(a.visEintrk, b.visEintrk) && SameValue(a.eff, b.eff) &&
+    SameValue(a.pur, b.pur) && SameValue(a.eff_cryo, b.eff_cryo);
+}
+
+caf::SRTrackTruth MatchTrack2Truth(const CAFRecoUtils::HitTruthCache &hit_truth, const std::vector<caf::SRTrueParticle> &particles, const std::vector<art::Ptr<recob::Hit>> &hits,
+				   const caf::TrackIDMap<caf::HitsEnergy> &all_hits_map, bool validate) {
+
+  // One pass over the hits, summing the energy of each ID and counting the
+  // hits it leads. The ID is the same as the mcparticle ID as long as we got
+  // it from geant4.
+  std::map<int, TrackIDMatch> id_sums;
+  float total_energy = 0.;
+  for (const art::Ptr<recob::Hit> &hit: hits) {
+    id_sums[hit_truth.ShowerPrimary(CAFRecoUtils::TrueParticleID(hit_truth, hit, true))].nHits++;
+
+    for (const CAFRecoUtils::HitTrackIDE &ide: hit_truth.at(hit)) {
+      TrackIDMatch &sum = id_sums[hit_truth.ShowerPrimary(std::abs(ide.trackID))];
+      sum.energy += ide.energy;
+      sum.hasIDE = true;
+      total_energy += ide.energy;
+    }
+  }
+
+  // Hits without any IDE still count towards the "leading" ID of no
+  // particle, but that is not a match
+  std::vector<std::pair<int, TrackIDMatch>> id_matches;
+  for (auto const &pair: id_sums) {
+    if (pair.second.hasIDE) id_matches.push_back(pair);
+  }
+
+  caf::SRTrackTruth ret = FinishTrack2Truth(particles, hits, all_hits_map, id_matches, total_energy);
+
+  if (validate) {
+    const caf::SRTrackTruth ref = MatchTrack2TruthReference(hit_truth, particles, hits, all_hits_map);
+    if (!SameTrackTruth(ret, ref)) {
+      std::cout << "CAFMaker: track truth matching disagrees with the reference implementation"
+                << " (" << hits.size() << " hits, best match G4ID " << ret.bestmatch.G4ID
+                << " vs " << ref.bestmatch.G4ID << "). "
+                << "Set 'ValidateTruthMatching: false' to continue anyway." << std::endl;
+      abort();
+    }
+  }
+
   return ret;
 }//MatchTrack2Truth
+
+// The original implementation, which backtracks the hits separately for
+// the energy matches and for the per-ID hit counts. Used to validate
+// MatchTrack2Truth.
+caf::SRTrackTruth MatchTrack2TruthReference(const CAFRecoUtils::HitTruthCache &hit_truth, const std::vector<caf::SRTrueParticle> &particles, const std::vector<art::Ptr<recob::Hit>> &hits,
+                                            const caf::TrackIDMap<caf::HitsEnergy> &all_hits_map) {
+
+  std::vector<std::pair<int, float>> matches = CAFRecoUtils::AllTrueParticleIDEnergyMatches(hit_truth, hits, true);
+  float total_energy = CAFRecoUtils::TotalHitEnergy(hit_truth, hits);
+  caf::TrackIDMap<caf::HitsEnergy> track_hits_map = caf::SetupIDHitEnergyMap(hits, hit_truth);
+
+  std::vector<std::pair<int, TrackIDMatch>> id_matches;
+  for (auto const &pair: matches) {
+    TrackIDMatch match;
+    match.energy = pair.second;
+    match.nHits = FindHitsEnergy(track_hits_map, pair.first).nHits;
+    match.hasIDE = true;
+    id_matches.emplace_back(pair.first, match);
+  }
+
+  return FinishTrack2Truth(particles, hits, all_hits_map, id_matches, total_energy);
+}//MatchTrack2TruthReference
 //------------------------------------------------
-caf::SRTruthMatch MatchSlice2Truth(const std::vector<art::Ptr<recob::Hit>> &hits,
-                                   const std::vector<art::Ptr<simb::MCTruth>> &truths,
-                                   const caf::SRTruthBranch &srmc,
-                                   const cheat::ParticleInventoryService &inventory_service,
-                                   const detinfo::DetectorClocksData &clockData) {
+caf::SliceTruthMatcher::SliceTruthMatcher(const std::vector<art::Ptr<simb::MCTruth>> &truths,
+                                          const caf::SRTruthBranch &srmc,
+                                          const cheat::ParticleInventoryService &inventory_service,
+                                          const CAFRecoUtils::HitTruthCache &hit_truth)
+  : fTruths(truths), fSRMC(srmc), fInventoryService(inventory_service), fHitTruth(hit_truth)
+{
+}
+
+int caf::SliceTruthMatcher::TruthIndex(int G4ID) {
+  auto it = fTruthIndex.find(G4ID);
+  if (it != fTruthIndex.end()) return it->second;
+
+  int index = -1;
+  try {
+    art::Ptr<simb::MCTruth> truth = fInventoryService.TrackIdToMCTruth_P(G4ID);
+    for (unsigned ind = 0; ind < fTruths.size(); ind++) {
+      if (truth == fTruths[ind]) {
+        index = ind;
+        break;
+      }
+    }
+  }
+  // Ignore track ID's that cannot be looked up
+  catch(...) {
+  }
+
+  fTruthIndex[G4ID] = index;
+  return index;
+}
+
+caf::SRTruthMatch caf::SliceTruthMatcher::Match(const std::vector<art::Ptr<recob::Hit>> &hits) {
+  const std::vector<art::Ptr<simb::MCTruth>> &truths = fTruths;
+  const caf::SRTruthBranch &srmc = fSRMC;
+  const CAFRecoUtils::HitTruthCache &hit_truth = fHitTruth;
+
   caf::SRTruthMatch ret;
-  float total_energy = CAFRecoUtils::TotalHitEnergy(clockData, hits);
+  float total_energy = CAFRecoUtils::TotalHitEnergy(hit_truth, hits);
   // speed optimization: if there are no truths, all the matching energy must be cosmic
   if (truths.empty()) {
     ret.visEinslc = total_energy / 1000. /* MeV -> GeV */;
@@ -1169,23 +1146,11 @@ caf::SRTruthMatch MatchSlice2Truth(const std::vector<art::Ptr<recob::Hit>> &hits
     ret.index = -1;
     return ret;
   }
-  std::vector<std::pair<int, float>> matches = CAFRecoUtils::AllTrueParticleIDEnergyMatches(clockData, hits, true);
+  std::vector<std::pair<int, float>> matches = CAFRecoUtils::AllTrueParticleIDEnergyMatches(hit_truth, hits, true);
   std::vector<float> matching_energy(truths.size(), 0.);
   for (auto const &pair: matches) {
-    art::Ptr<simb::MCTruth> truth;
-    try {
-      truth = inventory_service.TrackIdToMCTruth_P(pair.first);
-    }
-    // Ignore track ID's that cannot be looked up
-    catch(...) {
-      continue;
-    }
-    for (unsigned ind = 0; ind < truths.size(); ind++) {
-      if (truth == truths[ind]) {
-        matching_energy[ind] += pair.second;
-        break;
-      }
-    }
+    const int ind = TruthIndex(pair.first);
+    if (ind >= 0) matching_energy[ind] += pair.second;
   }
 
   float cosmic_energy = total_energy;
@@ -1230,4 +1195,4 @@ caf::SRTruthMatch MatchSlice2Truth(const std::vector<art::Ptr<recob::Hit>> &hits
     ret.eff_cryo = -1;
   }
   return ret;
-}//Slc2Truth
+}//SliceTruthMatcher::Match
@@ -35,6 +35,9 @@
 #include "sbnanaobj/StandardRecord/StandardRecord.h"
 #include "sbnanaobj/StandardRecord/SRMeVPrtl.h"
 
+#include "RecoUtils/RecoUtils.h"
+#include "TrackIDMap.h"
+
 namespace caf
 {
   struct HitsEnergy {
@@ -53,42 +56,64 @@ namespace caf
                     caf::SRGlobal& srglobal,
                     std::map<std::string, unsigned int>& weightPSetIndex);
 
-  void FillSliceTruth(const std::vector<art::Ptr<recob::Hit>> &hits,
-                      const std::vector<art::Ptr<simb::MCTruth>> &neutrinos,
+  /// \brief Matches slices to the true interactions of the event
+  ///
+  /// The match of a slice is computed once and handed to each of the
+  /// slice-level truth fillers. The interaction of each G4 ID is looked up in
+  /// the ParticleInventoryService only the first time it is seen.
+  class SliceTruthMatcher
+  {
+  public:
+    SliceTruthMatcher(const std::vector<art::Ptr<simb::MCTruth>> &neutrinos,
                       const caf::SRTruthBranch &srmc,
                       const cheat::ParticleInventoryService &inventory_service,
-                      const detinfo::DetectorClocksData &clockData,
-                      caf::SRSlice &srslice, 
-                      bool allowEmpty = false);
+                      const CAFRecoUtils::HitTruthCache &hit_truth);
+
+    /// Match of the slice made of \a hits. Index is -1 if unmatched.
+    caf::SRTruthMatch Match(const std::vector<art::Ptr<recob::Hit>> &hits);
+
+  private:
+    /// Index into the neutrinos of the interaction of \a G4ID, or -1
+    int TruthIndex(int G4ID);
+
+    const std::vector<art::Ptr<simb::MCTruth>> &fTruths;
+    const caf::SRTruthBranch &fSRMC;
+    const cheat::ParticleInventoryService &fInventoryService;
+    const CAFRecoUtils::HitTruthCache &fHitTruth;
+    std::map<int, int> fTruthIndex;
+  };
+
+  void FillSliceTruth(const caf::SRTruthMatch &tmatch,
+                      const caf::SRTruthBranch &srmc,
+                      caf::SRSlice &srslice);
 
-  void FillSliceFakeReco(const std::vector<art::Ptr<recob::Hit>> &hits,
+  void FillSliceFakeReco(const caf::SRTruthMatch &tmatch,
                          const std::vector<art::Ptr<simb::MCTruth>> &neutrinos,
-                         const caf::SRTruthBranch &srmc,
-                         const cheat::ParticleInventoryService &inventory_service,
-                         const detinfo::DetectorClocksData &clockData,
                          caf::SRSlice &srslice, 
                          const std::vector<art::Ptr<sim::MCTrack>> &mctracks,
+                         const std::vector<std::vector<unsigned>> &vertex_tracks,
                          const std::vector<geo::BoxBoundedGeo> &volumes, TRandom &rand);
 
   void FillTrueG4Particle(const simb::MCParticle &particle,
         const std::vector<geo::BoxBoundedGeo> &active_volumes,
         const std::vector<std::vector<geo::BoxBoundedGeo>> &tpc_volumes,
-        const std::map<int, std::vector<std::pair<geo::WireID, const sim::IDE *>>> &id_to_ide_map,
-        const std::map<int, std::vector<art::Ptr<recob::Hit>>> &id_to_truehit_map,
-        const cheat::BackTrackerService &backtracker,
-        const cheat::ParticleInventoryService &inventory_service,
-        const std::vector<art::Ptr<simb::MCTruth>> &neutrinos,
+        const caf::TrackIDMap<std::pair<geo::WireID, const sim::IDE*>> &id_to_ide_map,
+        const caf::TrackIDMap<art::Ptr<recob::Hit>> &id_to_truehit_map,
+        int interaction_id,
         caf::SRTrueParticle &srparticle);
 
   void FillMeVPrtlTruth(const evgen::ldm::MeVPrtlTruth &truth,
                         const std::vector<geo::BoxBoundedGeo> &active_volumes,
                         caf::SRMeVPrtl &srtruth);
 
+  /// \a interaction_particles are the indices into \a srparticles, in
+  /// ascending order, of the particles with interaction_id \a i
   void FillTrueNeutrino(const art::Ptr<simb::MCTruth> mctruth, 
 			const simb::MCFlux &mcflux, 
                         const simb::GTruth& gtruth,
 			const std::vector<caf::SRTrueParticle> &srparticles,
-                        const std::map<int, std::vector<art::Ptr<recob::Hit>>> &id_to_truehit_map,
+                        const std::vector<unsigned> &interaction_particles,
+                        const caf::TrackIDMap<art::Ptr<recob::Hit>> &id_to_truehit_map,
 			caf::SRTrueInteraction &srneutrino, size_t i,
                         const std::vector<geo::BoxBoundedGeo> &active_volumes);
 
@@ -97,37 +122,47 @@ namespace caf
                        const std::map<std::string, unsigned int>& weightPSetIndex);
 
   void FillTrackTruth(const std::vector<art::Ptr<recob::Hit>> &hits,
-                      const std::map<int, caf::HitsEnergy> &id_hits_map,
+                      const caf::TrackIDMap<caf::HitsEnergy> &id_hits_map,
                       const std::vector<caf::SRTrueParticle> &particles,
-                      const detinfo::DetectorClocksData &clockData,
+                      const CAFRecoUtils::HitTruthCache &hit_truth,
                       caf::SRTrack& srtrack,
-                      bool allowEmpty = false);
+                      bool allowEmpty = false,
+                      bool validate = false);
 
   void FillStubTruth(const std::vector<art::Ptr<recob::Hit>> &hits,
-                     const std::map<int, caf::HitsEnergy> &id_hits_map,
+                     const caf::TrackIDMap<caf::HitsEnergy> &id_hits_map,
                      const std::vector<caf::SRTrueParticle> &particles,
-                     const detinfo::DetectorClocksData &clockData,
+                     const CAFRecoUtils::HitTruthCache &hit_truth,
                      caf::SRStub& srstub,
-                     bool allowEmpty = false);
+                     bool allowEmpty = false,
+                     bool validate = false);
 
   void FillShowerTruth(const std::vector<art::Ptr<recob::Hit>> &hits,
-                       const std::map<int, caf::HitsEnergy> &id_hits_map,
+                       const caf::TrackIDMap<caf::HitsEnergy> &id_hits_map,
                        const std::vector<caf::SRTrueParticle> &particles,
-                       const detinfo::DetectorClocksData &clockData,
+                       const CAFRecoUtils::HitTruthCache &hit_truth,
                        caf::SRShower& srshower,
-                       bool allowEmpty = false);
+                       bool allowEmpty = false,
+                       bool validate = false);
 
   void FillFakeReco(const std::vector<art::Ptr<simb::MCTruth>> &mctruths, 
                     const std::vector<art::Ptr<sim::MCTrack>> &mctracks, 
+                    const std::vector<std::vector<unsigned>> &vertex_tracks,
                     const std::vector<geo::BoxBoundedGeo> &volumes,
                     TRandom &rand,
                     std::vector<caf::SRFakeReco> &srfakereco);
 
-  std::map<int, std::vector<std::pair<geo::WireID, const sim::IDE*>>> PrepSimChannels(const std::vector<art::Ptr<sim::SimChannel>> &simchannels, const geo::GeometryCore &geo);
-  std::map<int, std::vector<art::Ptr<recob::Hit>>> PrepTrueHits(const std::vector<art::Ptr<recob::Hit>> &allHits, 
-    const detinfo::DetectorClocksData &clockData, const cheat::BackTrackerService &backtracker);
-  std::map<int, caf::HitsEnergy> SetupIDHitEnergyMap(const std::vector<art::Ptr<recob::Hit>> &allHits, const detinfo::DetectorClocksData &clockData, 
-    const cheat::BackTrackerService &backtracker);
+  /// For each MCTruth, the indices into \a mctracks, in ascending order, of
+  /// the primary tracks starting at its neutrino vertex. Empty for MCTruths
+  /// without a neutrino.
+  std::vector<std::vector<unsigned>> PrepFakeRecoTracks(const std::vector<art::Ptr<simb::MCTruth>> &mctruths,
+                                                        const std::vector<art::Ptr<sim::MCTrack>> &mctracks);
+
+  caf::TrackIDMap<std::pair<geo::WireID, const sim::IDE*>> PrepSimChannels(const std::vector<art::Ptr<sim::SimChannel>> &simchannels, const geo::GeometryCore &geo);
+  caf::TrackIDMap<art::Ptr<recob::Hit>> PrepTrueHits(const std::vector<art::Ptr<recob::Hit>> &allHits, 
+    const CAFRecoUtils::HitTruthCache &hit_truth);
+  caf::TrackIDMap<caf::HitsEnergy> SetupIDHitEnergyMap(const std::vector<art::Ptr<recob::Hit>> &allHits,
+    const CAFRecoUtils::HitTruthCache &hit_truth);
 
 }
 
@@ -0,0 +1,39 @@
+#include "sbncafmaker/CAFMaker/FlatBranchSelection.h"
+
+#include <fnmatch.h>
+
+namespace caf
+{
+  //......................................................................
+  FlatBranchSelection::FlatBranchSelection(const std::vector<std::string>& include,
+                                           const std::vector<std::string>& exclude)
+    : fInclude(include), fExclude(exclude)
+  {
+  }
+
+  //......................................................................
+  bool FlatBranchSelection::Include(const std::string& name) const
+  {
+    return Matches(fInclude, name) && !Matches(fExclude, name);
+  }
+
+  //......................................................................
+  bool FlatBranchSelection::SelectsAll() const
+  {
+    if(!fExclude.empty()) return false;
+    for(const std::string& pattern: fInclude) if(pattern == "*") return true;
+    return false;
+  }
+
+  //......................................................................
+  bool FlatBranchSelection::Matches(const std::vector<std::string>& patterns,
+                                    const std::string& name)
+  {
+    for(const std::string& pattern: patterns){
+      if(fnmatch(pattern.c_str(), name.c_str(), 0) == 0) return true;
+      // Children of a matching branch
+      if(fnmatch((pattern + ".*").c_str(), name.c_str(), 0) == 0) return true;
+    }
+    return false;
+  }
+}
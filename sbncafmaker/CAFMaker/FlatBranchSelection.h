@@ -0,0 +1,44 @@
+//////////////////////////////////////////////////////////////////////
+// \file    FlatBranchSelection.h
+// \brief   Chooses which branches of the flat CAF are written, from
+//          glob patterns on their dotted names
+//////////////////////////////////////////////////////////////////////
+
+#ifndef CAF_FLATBRANCHSELECTION_H
+#define CAF_FLATBRANCHSELECTION_H
+
+#include "SRProxy/FlatBasicTypes.h"
+
+#include <string>
+#include <vector>
+
+namespace caf
+{
+  /// \brief Branch policy for flat::Flat built from include/exclude globs
+  ///
+  /// A branch is written if it matches at least one include pattern and no
+  /// exclude pattern. Patterns use fnmatch syntax, where '*' also matches
+  /// dots. A pattern matches a branch's children too, so "rec.hdr" selects
+  /// every branch under rec.hdr. Dropped branches are never created, so
+  /// they cost nothing to fill.
+  class FlatBranchSelection : public flat::IBranchPolicy
+  {
+  public:
+    FlatBranchSelection(const std::vector<std::string>& include,
+                        const std::vector<std::string>& exclude);
+
+    virtual bool Include(const std::string& name) const override;
+
+    /// Whether every branch is selected, so no policy is needed at all
+    bool SelectsAll() const;
+
+  protected:
+    static bool Matches(const std::vector<std::string>& patterns,
+                        const std::string& name);
+
+    std::vector<std::string> fInclude;
+    std::vector<std::string> fExclude;
+  };
+}
+
+#endif
@@ -0,0 +1,106 @@
+//////////////////////////////////////////////////////////////////////
+// \file    G4ProcessTable.h
+// \brief   Geant4 process names and the caf::g4_process_ they map to,
+//          sorted by name so that they can be binary searched
+//////////////////////////////////////////////////////////////////////
+
+#ifndef CAF_G4PROCESSTABLE_H
+#define CAF_G4PROCESSTABLE_H
+
+#include "sbnanaobj/StandardRecord/SREnums.h"
+
+#include <algorithm>
+#include <iterator>
+#include <string_view>
+
+namespace caf
+{
+  struct G4ProcessName {
+    std::string_view name;
+    g4_process_ id;
+  };
+
+  constexpr G4ProcessName kG4ProcessNames[] = {
+    {"CoulombScat",                   kG4CoulombScat},
+    {"CoupledTransportation",         kG4CoupledTransportation},
+    {"Decay",                         kG4Decay},
+    {"FastScintillation",             kG4FastScintillation},
+    {"He3Inelastic",                  kG4He3Inelastic},
+    {"LArVoxelReadoutScoringProcess", kG4LArVoxelReadoutScoringProcess},
+    {"StepLimiter",                   kG4StepLimiter},
+    {"Transportation",                kG4Transportation},
+    {"alphaInelastic",                kG4alphaInelastic},
+    {"annihil",                       kG4annihil},
+    {"anti-lambdaInelastic",          kG4anti_lambdaInelastic},
+    {"anti_neutronElastic",           kG4anti_neutronElastic},
+    {"anti_neutronInelastic",         kG4anti_neutronInelastic},
+    {"anti_protonElastic",            kG4anti_protonElastic},
+    {"anti_protonInelastic",          kG4anti_protonInelastic},
+    {"compt",                         kG4compt},
+    {"conv",                          kG4conv},
+    {"dInelastic",                    kG4dInelastic},
+    {"eBrem",                         kG4eBrem},
+    {"eIoni",                         kG4eIoni},
+    {"electronNuclear",               kG4electronNuclear},
+    {"hBertiniCaptureAtRest",         kG4hBertiniCaptureAtRest},
+    {"hBrems",                        kG4hBrems},
+    {"hFritiofCaptureAtRest",         kG4hFritiofCaptureAtRest},
+    {"hIoni",                         kG4hIoni},
+    {"hPairProd",                     kG4hPairProd},
+    {"hadElastic",                    kG4hadElastic},
+    {"hadInelastic",                  kG4hadInelastic},
+    {"ionInelastic",                  kG4ionInelastic},
+    {"ionIoni",                       kG4ionIoni},
+    {"kaon+Elastic",                  kG4kaonpElastic},
+    {"kaon+Inelastic",                kG4kaonpInelastic},
+    {"kaon-Elastic",                  kG4kaonmElastic},
+    {"kaon-Inelastic",                kG4kaonmInelastic},
+    {"kaon0LInelastic",               kG4kaon0LInelastic},
+    {"kaon0SInelastic",               kG4kaon0SInelastic},
+    {"lambdaInelastic",               kG4lambdaInelastic},
+    {"msc",                           kG4msc},
+    {"muBrems",                       kG4muBrems},
+    {"muIoni",                        kG4muIoni},
+    {"muMinusCaptureAtRest",          kG4muMinusCaptureAtRest},
+    {"muPairProd",                    kG4muPairProd},
+    {"muonNuclear",                   kG4muonNuclear},
+    {"nCapture",                      kG4nCapture},
+    {"nKiller",                       kG4nKiller},
+    {"neutronElastic",                kG4neutronElastic},
+    {"neutronInelastic",              kG4neutronInelastic},
+    {"phot",                          kG4phot},
+    {"photonNuclear",                 kG4photonNuclear},
+    {"pi+Elastic",                    kG4pipElastic},
+    {"pi+Inelastic",                  kG4pipInelastic},
+    {"pi-Elastic",                    kG4pimElastic},
+    {"pi-Inelastic",                  kG4pimInelastic},
+    {"positronNuclear",               kG4positronNuclear},
+    {"primary",                       kG4primary},
+    {"protonElastic",                 kG4protonElastic},
+    {"protonInelastic",               kG4protonInelastic},
+    {"sigma+Inelastic",               kG4sigmapInelastic},
+    {"sigma-Inelastic",               kG4sigmamInelastic},
+    {"tInelastic",                    kG4tInelastic},
+    {"xi+Inelastic",                  kG4xipInelastic},
+    {"xi-Inelastic",                  kG4ximInelastic},
+    {"xi0Inelastic",                  kG4xi0Inelastic},
+  };
+
+  constexpr bool G4ProcessNamesSorted() {
+    for (size_t i = 1; i < std::size(kG4ProcessNames); i++) {
+      if (!(kG4ProcessNames[i-1].name < kG4ProcessNames[i].name)) return false;
+    }
+    return true;
+  }
+  static_assert(G4ProcessNamesSorted(), "kG4ProcessNames must be sorted by name, without duplicates");
+
+  /// The process called \a name, or kG4UNKNOWN if there is none
+  inline g4_process_ FindG4Process(std::string_view name) {
+    const G4ProcessName *it = std::lower_bound(std::begin(kG4ProcessNames), std::end(kG4ProcessNames), name,
+      [](const G4ProcessName &a, std::string_view b) { return a.name < b; });
+    if (it == std::end(kG4ProcessNames) || it->name != name) return kG4UNKNOWN;
+    return it->id;
+  }
+}
+
+#endif
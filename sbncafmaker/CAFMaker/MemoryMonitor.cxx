@@ -0,0 +1,127 @@
+#include "sbncafmaker/CAFMaker/MemoryMonitor.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+
+#include <unistd.h>
+
+namespace caf
+{
+  //......................................................................
+  MemoryMonitor::MemoryMonitor(bool enabled, double outlier_factor)
+    : fEnabled(enabled), fOutlierFactor(outlier_factor), fLastRSS(0)
+  {
+  }
+
+  //......................................................................
+  size_t MemoryMonitor::CurrentRSS()
+  {
+    // Second field, in pages
+    FILE* f = fopen("/proc/self/statm", "r");
+    if(!f) return 0;
+    long size = 0, resident = 0;
+    if(fscanf(f, "%ld %ld", &size, &resident) != 2) resident = 0;
+    fclose(f);
+    return size_t(resident) * sysconf(_SC_PAGESIZE);
+  }
+
+  //......................................................................
+  size_t MemoryMonitor::PeakRSS()
+  {
+    FILE* f = fopen("/proc/self/status", "r");
+    if(!f) return 0;
+    char line[256];
+    size_t ret = 0;
+    while(fgets(line, sizeof(line), f)){
+      if(strncmp(line, "VmHWM:", 6) == 0){
+        ret = strtoul(line + 6, 0, 10) * 1024; // in kB
+        break;
+      }
+    }
+    fclose(f);
+    return ret;
+  }
+
+  //......................................................................
+  void MemoryMonitor::BeginEvent(const EventID& id)
+  {
+    if(!fEnabled) return;
+    fEvent = id;
+    fLastRSS = CurrentRSS();
+  }
+
+  //......................................................................
+  void MemoryMonitor::Mark(const std::string& stage)
+  {
+    if(!fEnabled) return;
+    const size_t rss = CurrentRSS();
+    Add("rss_delta_" + stage, fEvent, double(rss) - double(fLastRSS));
+    fLastRSS = rss;
+  }
+
+  //......................................................................
+  void MemoryMonitor::Add(const std::string& name, const EventID& id, double bytes)
+  {
+    if(!fEnabled) return;
+
+    std::lock_guard<std::mutex> lock(fMutex);
+
+    auto it = fStats.find(name);
+    if(it == fStats.end()){
+      fOrder.push_back(name);
+      it = fStats.emplace(name, Stat()).first;
+    }
+    Stat& stat = it->second;
+
+    stat.sum += bytes;
+    stat.n++;
+
+    if(stat.top.size() < kNTop || bytes > stat.top.back().first){
+      auto pos = std::find_if(stat.top.begin(), stat.top.end(),
+                              [bytes](const std::pair<double, EventID>& x){ return bytes > x.first; });
+      stat.top.insert(pos, std::make_pair(bytes, id));
+      if(stat.top.size() > kNTop) stat.top.pop_back();
+    }
+  }
+
+  //......................................................................
+  void MemoryMonitor::Print(std::ostream& os) const
+  {
+    std::lock_guard<std::mutex> lock(fMutex);
+
+    const double MB = 1024*1024;
+
+    os << "CAFMaker memory report: peak RSS " << std::fixed << std::setprecision(1)
+       << PeakRSS()/MB << " MB\n";
+    os << "  " << std::left << std::setw(36) << "quantity" << std::right
+       << std::setw(12) << "mean [MB]" << std::setw(12) << "max [MB]" << "  max event\n";
+    for(const std::string& name: fOrder){
+      const Stat& stat = fStats.at(name);
+      const EventID& id = stat.top.front().second;
+      os << "  " << std::left << std::setw(36) << name << std::right
+         << std::setw(12) << stat.sum/stat.n/MB
+         << std::setw(12) << stat.top.front().first/MB
+         << "  " << id.run << "/" << id.subrun << "/" << id.evt << "\n";
+    }
+
+    os << "Outlier events (more than " << fOutlierFactor << " times the mean, run/subrun/event):\n";
+    bool any = false;
+    for(const std::string& name: fOrder){
+      const Stat& stat = fStats.at(name);
+      const double mean = stat.sum/stat.n;
+      if(mean <= 0) continue;
+      for(const std::pair<double, EventID>& x: stat.top){
+        if(x.first <= fOutlierFactor*mean) break;
+        os << "  " << std::left << std::setw(36) << name << std::right
+           << std::setw(12) << x.first/MB << " MB  "
+           << x.second.run << "/" << x.second.subrun << "/" << x.second.evt << "\n";
+        any = true;
+      }
+    }
+    if(!any) os << "  none\n";
+    os << std::defaultfloat << std::flush;
+  }
+}
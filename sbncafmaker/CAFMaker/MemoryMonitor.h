@@ -0,0 +1,95 @@
+//////////////////////////////////////////////////////////////////////
+// \file    MemoryMonitor.h
+// \brief   Per-event memory use of CAFMaker, to find the events and
+//          the stages responsible for large memory footprints
+//////////////////////////////////////////////////////////////////////
+
+#ifndef CAF_MEMORYMONITOR_H
+#define CAF_MEMORYMONITOR_H
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace caf
+{
+  /// \brief Records RSS changes per stage and sizes of large objects for
+  /// each event, and reports the events with the largest values
+  ///
+  /// Only the mean and the few largest values of each quantity are kept,
+  /// so the memory used does not grow with the number of events. Add()
+  /// may be called from any thread; the per-event stage calls must come
+  /// from the thread running produce().
+  class MemoryMonitor
+  {
+  public:
+    struct EventID {
+      unsigned run = 0, subrun = 0, evt = 0;
+    };
+
+    MemoryMonitor(bool enabled, double outlier_factor);
+
+    bool Enabled() const { return fEnabled; }
+
+    /// Start a new event at the current RSS
+    void BeginEvent(const EventID& id);
+    /// Attribute the RSS change since the previous mark to \a stage
+    void Mark(const std::string& stage);
+    /// Record a size in bytes for the current event
+    void Size(const std::string& name, size_t bytes) { Add(name, fEvent, bytes); }
+    /// Record a size in bytes for any event
+    void Add(const std::string& name, const EventID& id, double bytes);
+
+    /// Mean, maximum and outlier events of every quantity
+    void Print(std::ostream& os) const;
+
+    /// Current resident set size in bytes
+    static size_t CurrentRSS();
+    /// Peak resident set size of the process in bytes
+    static size_t PeakRSS();
+
+  protected:
+    static const unsigned kNTop = 5;
+
+    struct Stat {
+      double sum = 0;
+      unsigned n = 0;
+      std::vector<std::pair<double, EventID>> top; ///< Largest values, descending
+    };
+
+    bool fEnabled;
+    double fOutlierFactor;
+
+    EventID fEvent;
+    size_t fLastRSS;
+
+    mutable std::mutex fMutex;
+    std::vector<std::string> fOrder; ///< Quantities in order of first use
+    std::map<std::string, Stat> fStats;
+  };
+
+  /// Approximate heap bytes held by an object, not counting the object
+  /// itself. Only the standard containers are looked into.
+  template<class T> size_t HeapBytes(const T&) { return 0; }
+
+  template<class T> size_t HeapBytes(const std::vector<T>& v)
+  {
+    size_t ret = v.capacity() * sizeof(T);
+    for(const T& x: v) ret += HeapBytes(x);
+    return ret;
+  }
+
+  template<class K, class V> size_t HeapBytes(const std::map<K, V>& m)
+  {
+    // Each tree node holds the value, three pointers and the color
+    size_t ret = m.size() * (sizeof(std::pair<const K, V>) + 4*sizeof(void*));
+    for(const auto& it: m) ret += HeapBytes(it.second);
+    return ret;
+  }
+}
+
+#endif
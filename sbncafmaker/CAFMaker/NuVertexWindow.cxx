@@ -0,0 +1,18 @@
+#include "sbncafmaker/CAFMaker/NuVertexWindow.h"
+
+#include <algorithm>
+
+namespace caf
+{
+  std::pair<VertexZList::const_iterator, VertexZList::const_iterator>
+  VerticesNearZ(const VertexZList &vertices, double z, double window)
+  {
+    // z - vz only grows as vz goes down, including with rounding, so
+    // both ends are partition points
+    auto begin = std::partition_point(vertices.begin(), vertices.end(),
+      [z, window](const std::pair<double, unsigned> &v) { return z - v.first >= window; });
+    auto end = std::partition_point(begin, vertices.end(),
+      [z, window](const std::pair<double, unsigned> &v) { return v.first - z < window; });
+    return {begin, end};
+  }
+}
@@ -0,0 +1,29 @@
+//////////////////////////////////////////////////////////////////////
+// \file    NuVertexWindow.h
+// \brief   Neutrino vertices near a true track, for the fake reco
+//////////////////////////////////////////////////////////////////////
+
+#ifndef CAF_NUVERTEXWINDOW_H
+#define CAF_NUVERTEXWINDOW_H
+
+#include <utility>
+#include <vector>
+
+namespace caf
+{
+  /// A true track starting closer than this to a neutrino vertex comes
+  /// from it, in cm
+  constexpr float kNuVertexDistance = 5.;
+
+  /// (z, index) of the neutrino vertices, sorted by z
+  typedef std::vector<std::pair<double, unsigned>> VertexZList;
+
+  /// \brief The vertices whose z is less than \a window from \a z
+  ///
+  /// The distance is computed as (z - vertex z), as in TVector3, so every
+  /// vertex closer than \a window in 3D to a point at \a z is in the range.
+  std::pair<VertexZList::const_iterator, VertexZList::const_iterator>
+  VerticesNearZ(const VertexZList &vertices, double z, double window);
+}
+
+#endif
@@ -0,0 +1,105 @@
+#include "sbncafmaker/CAFMaker/PerfMonitor.h"
+
+#include "TFile.h"
+#include "TTree.h"
+
+#include <iomanip>
+#include <string>
+
+namespace caf
+{
+  //......................................................................
+  PerfMonitor::PerfMonitor(bool enabled)
+    : fEnabled(enabled)
+  {
+    for(int i = 0; i < kNStages; i++){
+      fNanos[i] = 0;
+      fCalls[i] = 0;
+    }
+    for(int i = 0; i < kNCounters; i++) fCounts[i] = 0;
+  }
+
+  //......................................................................
+  const char* PerfMonitor::StageName(EStage stage)
+  {
+    switch(stage){
+    case kProduce:          return "produce";
+    case kTruthPrep:        return "truth_prep";
+    case kTrueParticles:    return "true_particles";
+    case kTrueInteractions: return "true_interactions";
+    case kSliceGather:      return "slice_gather";
+    case kSliceReco:        return "slice_reco";
+    case kSliceTruth:       return "slice_truth";
+    case kWrite:            return "write";
+    default:                return "unknown";
+    }
+  }
+
+  //......................................................................
+  const char* PerfMonitor::CounterName(ECounter counter)
+  {
+    switch(counter){
+    case kEvents:            return "events";
+    case kSlices:            return "slices";
+    case kSelectedSlices:    return "selected_slices";
+    case kPFPs:              return "pfps";
+    case kHits:              return "hits";
+    case kBacktrackedHits:   return "backtracked_hits";
+    case kTrueParticleCount: return "true_particles";
+    default:                 return "unknown";
+    }
+  }
+
+  //......................................................................
+  void PerfMonitor::WriteTree(TFile* outfile) const
+  {
+    outfile->cd();
+
+    TTree* perfTree = new TTree("perfTree", "perfTree");
+    std::string name;
+    ULong64_t count;
+    double time;
+    perfTree->Branch("name", &name);
+    perfTree->Branch("count", &count); // calls of a stage, or counter value
+    perfTree->Branch("time", &time);   // seconds, 0 for counters
+
+    for(int i = 0; i < kNStages; i++){
+      name = StageName(EStage(i));
+      count = fCalls[i];
+      time = fNanos[i]*1e-9;
+      perfTree->Fill();
+    }
+    for(int i = 0; i < kNCounters; i++){
+      name = CounterName(ECounter(i));
+      count = fCounts[i];
+      time = 0;
+      perfTree->Fill();
+    }
+    perfTree->Write();
+  }
+
+  //......................................................................
+  void PerfMonitor::Print(std::ostream& os) const
+  {
+    const double nevt = fCounts[kEvents] > 0 ? double(fCounts[kEvents]) : 1.;
+
+    os << "CAFMaker timing summary (" << fCounts[kEvents] << " events):\n";
+    os << "  " << std::left << std::setw(20) << "stage"
+       << std::right << std::setw(12) << "total [s]" << std::setw(16) << "per event [ms]" << "\n";
+    for(int i = 0; i < kNStages; i++){
+      const double t = fNanos[i]*1e-9;
+      os << "  " << std::left << std::setw(20) << StageName(EStage(i))
+         << std::right << std::setw(12) << std::fixed << std::setprecision(3) << t
+         << std::setw(16) << 1e3*t/nevt << "\n";
+    }
+    os << "CAFMaker counters:\n";
+    os << "  " << std::left << std::setw(20) << "counter"
+       << std::right << std::setw(12) << "total" << std::setw(16) << "per event" << "\n";
+    for(int i = 0; i < kNCounters; i++){
+      os << "  " << std::left << std::setw(20) << CounterName(ECounter(i))
+         << std::right << std::setw(12) << fCounts[i]
+         << std::setw(16) << std::setprecision(1) << fCounts[i]/nevt << "\n";
+    }
+    os << std::defaultfloat << std::flush;
+  }
+}
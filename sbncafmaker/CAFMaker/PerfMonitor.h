@@ -0,0 +1,109 @@
+//////////////////////////////////////////////////////////////////////
+// \file    PerfMonitor.h
+// \brief   Job-level timers and counters for the stages of
+//          CAFMaker::produce
+//////////////////////////////////////////////////////////////////////
+
+#ifndef CAF_PERFMONITOR_H
+#define CAF_PERFMONITOR_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+class TFile;
+
+namespace caf
+{
+  /// \brief Accumulates wall time per stage and object counts over a job
+  ///
+  /// Safe to use from several threads at once. When disabled, a Scope
+  /// does not read the clock, so the cost is one branch per stage.
+  class PerfMonitor
+  {
+  public:
+    enum EStage {
+      kProduce,           ///< All of produce()
+      kTruthPrep,         ///< Backtracking the hits, PrepSimChannels, PrepTrueHits, SetupIDHitEnergyMap
+      kTrueParticles,     ///< FillTrueG4Particle
+      kTrueInteractions,  ///< Neutrino, fake reco and MeVPrtl truth
+      kSliceGather,       ///< Slice association lookup, slice vars and selection
+      kSliceReco,         ///< Filling the reco objects of the slices
+      kSliceTruth,        ///< Slice truth matching and the merge into the record
+      kWrite,             ///< Filling the output trees
+      kNStages
+    };
+
+    enum ECounter {
+      kEvents,
+      kSlices,            ///< Before selection
+      kSelectedSlices,
+      kPFPs,              ///< In selected slices
+      kHits,
+      kBacktrackedHits,   ///< Distinct hits backtracked
+      kTrueParticleCount,
+      kNCounters
+    };
+
+    /// Adds the time from construction to destruction to a stage
+    class Scope
+    {
+    public:
+      Scope(PerfMonitor& mon, EStage stage)
+        : fMon(mon.fEnabled ? &mon : nullptr), fStage(stage)
+      {
+        if(fMon) fStart = std::chrono::steady_clock::now();
+      }
+      ~Scope() { Stop(); }
+
+      /// End the scope early
+      void Stop()
+      {
+        if(fMon) fMon->AddTime(fStage, std::chrono::steady_clock::now() - fStart);
+        fMon = nullptr;
+      }
+
+      Scope(const Scope&) = delete;
+      Scope& operator=(const Scope&) = delete;
+
+    protected:
+      PerfMonitor* fMon;
+      EStage fStage;
+      std::chrono::steady_clock::time_point fStart;
+    };
+
+    explicit PerfMonitor(bool enabled);
+
+    bool Enabled() const { return fEnabled; }
+
+    void Count(ECounter counter, uint64_t n = 1)
+    {
+      if(fEnabled) fCounts[counter].fetch_add(n, std::memory_order_relaxed);
+    }
+
+    /// Write the totals as a "perfTree" with one entry per stage or counter
+    void WriteTree(TFile* outfile) const;
+
+    /// Human-readable summary, with per-event averages
+    void Print(std::ostream& os) const;
+
+    static const char* StageName(EStage stage);
+    static const char* CounterName(ECounter counter);
+
+  protected:
+    void AddTime(EStage stage, std::chrono::steady_clock::duration dt)
+    {
+      fNanos[stage].fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(dt).count(),
+                              std::memory_order_relaxed);
+      fCalls[stage].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    bool fEnabled;
+    std::atomic<uint64_t> fNanos[kNStages];
+    std::atomic<uint64_t> fCalls[kNStages];
+    std::atomic<uint64_t> fCounts[kNCounters];
+  };
+}
+
+#endif
@@ -1,5 +1,161 @@
 #include "RecoUtils.h"
 
+#include "cetlib_except/exception.h"
+
+#include <algorithm>
+#include <limits>
+
+CAFRecoUtils::ShowerPrimaryTable::ShowerPrimaryTable(const sim::ParticleList &particles) {
+  if (particles.empty()) return;
+
+  // The list is ordered by track ID
+  std::vector<int> ids;
+  std::vector<int> mothers;
+  std::vector<bool> em;
+  ids.reserve(particles.size());
+  mothers.reserve(particles.size());
+  em.reserve(particles.size());
+  for (auto const &pair: particles) {
+    const simb::MCParticle *part = pair.second;
+    ids.push_back(pair.first);
+    // Dropped particles are kept in the list without a pointer. Treat them
+    // as the end of any chain.
+    em.push_back(part && (std::abs(part->PdgCode()) == 11 || part->PdgCode() == 22));
+    mothers.push_back(part ? part->Mother() : kNoParticle);
+  }
+
+  auto index = [&ids](int id) -> int {
+    auto it = std::lower_bound(ids.begin(), ids.end(), id);
+    return (it != ids.end() && *it == id) ? std::distance(ids.begin(), it) : -1;
+  };
+
+  std::vector<int> primary(ids.size(), kNoParticle);
+  std::vector<int> chain;
+  for (unsigned i = 0; i < ids.size(); i++) {
+    if (primary[i] != kNoParticle) continue;
+    if (!em[i]) {
+      primary[i] = ids[i];
+      continue;
+    }
+
+    // Walk up through EM mothers until the top of the chain, or a particle
+    // that has already been resolved
+    chain.clear();
+    int j = i;
+    int result = kNoParticle;
+    while (true) {
+      chain.push_back(j);
+      const int k = index(mothers[j]);
+      if (k < 0 || !em[k]) {
+        result = ids[j];
+        break;
+      }
+      if (primary[k] != kNoParticle) {
+        result = primary[k];
+        break;
+      }
+      j = k;
+    }
+    for (int c: chain) primary[c] = result;
+  }
+
+  // Dense when it costs at most a few times the sparse list
+  const long range = (long)ids.back() - (long)ids.front() + 1;
+  if (range <= 4 * (long)ids.size()) {
+    fMinID = ids.front();
+    fDense.assign(range, kNoParticle);
+    for (unsigned i = 0; i < ids.size(); i++) fDense[ids[i] - fMinID] = primary[i];
+  }
+  else {
+    fSparse.reserve(ids.size());
+    for (unsigned i = 0; i < ids.size(); i++) fSparse.emplace_back(ids[i], primary[i]);
+  }
+}
+
+int CAFRecoUtils::ShowerPrimaryTable::Get(int g4ID) const {
+  if (!fDense.empty()) {
+    const long i = (long)g4ID - fMinID;
+    if (i < 0 || i >= (long)fDense.size() || fDense[i] == kNoParticle) return g4ID;
+    return fDense[i];
+  }
+
+  auto it = std::lower_bound(fSparse.begin(), fSparse.end(), g4ID,
+                             [](const std::pair<int, int> &a, int b) { return a.first < b; });
+  if (it == fSparse.end() || it->first != g4ID) return g4ID;
+  return it->second;
+}
+
+void CAFRecoUtils::HitTruthCache::Add(const std::vector<art::Ptr<recob::Hit>> &hits, const detinfo::DetectorClocksData &clockData, const cheat::BackTrackerService &backtracker) {
+  for (const art::Ptr<recob::Hit> &hit: hits) {
+    std::vector<std::pair<unsigned, unsigned>> &ranges = fRanges[hit.id()];
+    if (ranges.size() <= hit.key()) ranges.resize(hit.key()+1, {kNotAdded, kNotAdded});
+    if (ranges[hit.key()].first != kNotAdded) continue;
+
+    const unsigned begin = fIDEs.size();
+    for (const sim::TrackIDE &ide: backtracker.HitToTrackIDEs(clockData, hit)) {
+      fIDEs.push_back({ide.trackID, ide.energy});
+    }
+    ranges[hit.key()] = {begin, (unsigned)fIDEs.size()};
+    fNHits++;
+  }
+}
+
+CAFRecoUtils::HitTruthCache::Range CAFRecoUtils::HitTruthCache::at(const art::Ptr<recob::Hit> &hit) const {
+  auto it = fRanges.find(hit.id());
+  if (it == fRanges.end() || it->second.size() <= hit.key() || it->second[hit.key()].first == kNotAdded) {
+    throw cet::exception("HitTruthCache") << "Hit " << hit.id() << " key " << hit.key()
+                                          << " was not backtracked before its truth was requested.";
+  }
+  const std::pair<unsigned, unsigned> &range = it->second[hit.key()];
+  return {fIDEs.data() + range.first, fIDEs.data() + range.second};
+}
+
+std::vector<std::pair<int, float>> CAFRecoUtils::AllTrueParticleIDEnergyMatches(const HitTruthCache &hit_truth, const std::vector<art::Ptr<recob::Hit> >& hits, bool rollup_unsaved_ids) {
+  std::map<int, float> trackIDToEDepMap;
+  for (const art::Ptr<recob::Hit> &hit: hits) {
+    for (const HitTrackIDE &ide: hit_truth.at(hit)) {
+      int id = ide.trackID;
+      if (rollup_unsaved_ids) id = std::abs(id);
+      id = hit_truth.ShowerPrimary(id);
+      trackIDToEDepMap[id] += ide.energy;
+    }
+  }
+
+  std::vector<std::pair<int, float>> ret;
+  for (auto const &pair: trackIDToEDepMap) {
+    ret.push_back(pair);
+  }
+  return ret;
+}
+
+float CAFRecoUtils::TotalHitEnergy(const HitTruthCache &hit_truth, const std::vector<art::Ptr<recob::Hit> >& hits) {
+  float ret = 0.;
+  for (const art::Ptr<recob::Hit> &hit: hits) {
+    for (const HitTrackIDE &ide: hit_truth.at(hit)) {
+      ret += ide.energy;
+    }
+  }
+  return ret;
+}
+
+int CAFRecoUtils::TrueParticleID(const HitTruthCache &hit_truth, const art::Ptr<recob::Hit> &hit, bool rollup_unsaved_ids) {
+  // A hit only has a handful of contributors -- sum them up in a small
+  // vector kept in increasing ID order, as TruthMatchUtils does with a map
+  std::vector<std::pair<int, float>> idToEDep;
+  for (const HitTrackIDE &ide: hit_truth.at(hit)) {
+    const int id = rollup_unsaved_ids ? std::abs(ide.trackID) : ide.trackID;
+    auto it = std::lower_bound(idToEDep.begin(), idToEDep.end(), id,
+                               [](const std::pair<int, float> &a, int b) { return a.first < b; });
+    if (it == idToEDep.end() || it->first != id) it = idToEDep.insert(it, {id, 0.f});
+    it->second += ide.energy;
+  }
+
+  if (idToEDep.empty()) return std::numeric_limits<int>::lowest();
+
+  return std::max_element(idToEDep.begin(), idToEDep.end(),
+                          [](const std::pair<int, float> &a, const std::pair<int, float> &b) { return a.second < b.second; })->first;
+}
+
 std::vector<std::pair<int, float>> CAFRecoUtils::AllTrueParticleIDEnergyMatches(const detinfo::DetectorClocksData &clockData, const std::vector<art::Ptr<recob::Hit> >& hits, bool rollup_unsaved_ids) {
   art::ServiceHandle<cheat::BackTrackerService> bt_serv;
   std::map<int, float> trackIDToEDepMap;
@@ -17,6 +17,7 @@
 #include "canvas/Persistency/Common/Ptr.h" 
 #include "canvas/Persistency/Common/PtrVector.h" 
 #include "canvas/Persistency/Common/FindManyP.h"
+#include "canvas/Persistency/Provenance/ProductID.h"
 
 // LArSoft
 #include "nusimdata/SimulationBase/MCParticle.h"
@@ -33,14 +34,84 @@
 // c++
 #include <vector>
 #include <map>
+#include <limits>
 
 // ROOT
 #include "TTree.h"
 
 namespace CAFRecoUtils{
 
+  /// Energy deposited in a hit by one true particle
+  struct HitTrackIDE {
+    int trackID;
+    float energy;
+  };
+
+  /// \brief Shower-primary ID (see GetShowerPrimary) of every particle in a
+  /// sim::ParticleList, resolved once
+  ///
+  /// Each e+/e-/gamma ancestry chain is walked a single time, with the
+  /// result of every particle along it memoized. The table is dense in the
+  /// track ID when the IDs are compact, and a sorted list otherwise.
+  class ShowerPrimaryTable {
+  public:
+    ShowerPrimaryTable() {}
+    explicit ShowerPrimaryTable(const sim::ParticleList &particles);
+
+    /// Same result as GetShowerPrimary(g4ID) for the list this was built from
+    int Get(int g4ID) const;
+
+  private:
+    int fMinID = 0;
+    std::vector<int> fDense; ///< Primary of ID fMinID+i, or kNoParticle
+    std::vector<std::pair<int, int>> fSparse; ///< (ID, primary), sorted by ID
+
+    static constexpr int kNoParticle = std::numeric_limits<int>::lowest();
+  };
+
+  /// \brief Per-event cache of the true energy deposits in each hit
+  ///
+  /// Each hit is backtracked (BackTrackerService::HitToTrackIDEs) once when
+  /// it is added, and all of the truth matching then reads from here.
+  class HitTruthCache {
+  public:
+    struct Range {
+      const HitTrackIDE *first;
+      const HitTrackIDE *last;
+      const HitTrackIDE *begin() const { return first; }
+      const HitTrackIDE *end() const { return last; }
+    };
+
+    /// Backtrack any of \a hits not already in the cache
+    void Add(const std::vector<art::Ptr<recob::Hit>> &hits, const detinfo::DetectorClocksData &clockData, const cheat::BackTrackerService &backtracker);
+
+    /// The energy deposits in \a hit, which must have been added before
+    Range at(const art::Ptr<recob::Hit> &hit) const;
+
+    /// Number of hits backtracked so far
+    size_t NHits() const { return fNHits; }
+
+    /// Set the shower-primary table used by the truth matching of this event
+    void SetShowerPrimaries(ShowerPrimaryTable table) { fShowerPrimaries = std::move(table); }
+    int ShowerPrimary(int g4ID) const { return fShowerPrimaries.Get(g4ID); }
+
+  private:
+    static constexpr unsigned kNotAdded = (unsigned)-1;
+
+    std::map<art::ProductID, std::vector<std::pair<unsigned, unsigned>>> fRanges; ///< [begin, end) in fIDEs, indexed by hit key
+    std::vector<HitTrackIDE> fIDEs;
+    size_t fNHits = 0;
+    ShowerPrimaryTable fShowerPrimaries;
+  };
+
   std::vector<std::pair<int, float>> AllTrueParticleIDEnergyMatches(const detinfo::DetectorClocksData &clockData, const std::vector<art::Ptr<recob::Hit> >& hits, bool rollup_unsaved_ids=1);
+  std::vector<std::pair<int, float>> AllTrueParticleIDEnergyMatches(const HitTruthCache &hit_truth, const std::vector<art::Ptr<recob::Hit> >& hits, bool rollup_unsaved_ids=1);
   float TotalHitEnergy(const detinfo::DetectorClocksData &clockData, const std::vector<art::Ptr<recob::Hit> >& hits);
+  float TotalHitEnergy(const HitTruthCache &hit_truth, const std::vector<art::Ptr<recob::Hit> >& hits);
+
+  /// Same as TruthMatchUtils::TrueParticleID (the ID depositing the most
+  /// energy, or the lowest int if there is none), but read from the cache
+  int TrueParticleID(const HitTruthCache &hit_truth, const art::Ptr<recob::Hit> &hit, bool rollup_unsaved_ids=1);
 
   float TrackPurity(const detinfo::DetectorClocksData &clockData, int mcparticle_id, const std::vector<art::Ptr<recob::Hit>> &reco_track_hits);
   float TrackCompletion(const detinfo::DetectorClocksData &clockData, int mcparticle_id, const std::vector<art::Ptr<recob::Hit>> &reco_track_hits);
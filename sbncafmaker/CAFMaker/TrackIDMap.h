@@ -0,0 +1,159 @@
+//////////////////////////////////////////////////////////////////////
+// \file    TrackIDMap.h
+// \brief   Flat map from G4 track ID to a contiguous range of values,
+//          for the per-event truth tables that are built once and then
+//          only read
+//////////////////////////////////////////////////////////////////////
+
+#ifndef CAF_TRACKIDMAP_H
+#define CAF_TRACKIDMAP_H
+
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace caf
+{
+  /// \brief Read-only map from track ID to the values filed under it
+  ///
+  /// Replaces a std::map<int, std::vector<T>>: the values of all IDs sit in
+  /// one array, in order of ID, and each ID owns a contiguous range of it.
+  /// Values with the same ID keep the order they were given in. When the
+  /// IDs are compact (the usual case for G4 track IDs) the range is found
+  /// by direct indexing; otherwise by binary search over the sorted IDs.
+  template <class T>
+  class TrackIDMap
+  {
+  public:
+    /// Values of one ID. Empty if the ID is absent.
+    class Range
+    {
+    public:
+      Range() : fBegin(nullptr), fEnd(nullptr) {}
+      Range(const T* b, const T* e) : fBegin(b), fEnd(e) {}
+
+      const T* begin() const { return fBegin; }
+      const T* end() const { return fEnd; }
+      size_t size() const { return fEnd - fBegin; }
+      bool empty() const { return fBegin == fEnd; }
+      const T& operator[](size_t i) const { return fBegin[i]; }
+
+    private:
+      const T* fBegin;
+      const T* fEnd;
+    };
+
+    TrackIDMap() : fDense(true), fMinID(0), fNIDs(0) {}
+
+    /// Build from (track ID, value) pairs, in any order of ID
+    explicit TrackIDMap(const std::vector<std::pair<int, T>>& entries)
+      : TrackIDMap()
+    {
+      if(entries.empty()) return;
+
+      const auto minmax = std::minmax_element(entries.begin(), entries.end(),
+                                              [](const std::pair<int, T>& a, const std::pair<int, T>& b){ return a.first < b.first; });
+      fMinID = minmax.first->first;
+      const long range = long(minmax.second->first) - fMinID + 1;
+
+      // Same density criterion as CAFRecoUtils::ShowerPrimaryTable
+      fDense = range <= 4*long(entries.size());
+
+      if(fDense){
+        // Counting sort. Entry k+1 holds the count of ID fMinID+k, so that
+        // the prefix sum yields the range starts.
+        fOffsets.assign(range + 1, 0);
+        for(const std::pair<int, T>& e: entries) fOffsets[e.first - fMinID + 1]++;
+        for(long k = 0; k < range; k++) if(fOffsets[k+1] > 0) fNIDs++;
+        std::partial_sum(fOffsets.begin(), fOffsets.end(), fOffsets.begin());
+
+        fValues.resize(entries.size());
+        std::vector<unsigned> cursor(fOffsets.begin(), fOffsets.end() - 1);
+        for(const std::pair<int, T>& e: entries) fValues[cursor[e.first - fMinID]++] = e.second;
+      }
+      else{
+        std::vector<unsigned> order(entries.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(),
+                         [&entries](unsigned a, unsigned b){ return entries[a].first < entries[b].first; });
+
+        fValues.reserve(entries.size());
+        for(unsigned i: order){
+          if(fIDs.empty() || fIDs.back() != entries[i].first){
+            fIDs.push_back(entries[i].first);
+            fOffsets.push_back(fValues.size());
+          }
+          fValues.push_back(entries[i].second);
+        }
+        fOffsets.push_back(fValues.size());
+        fNIDs = fIDs.size();
+      }
+    }
+
+    /// Equivalent of std::map::count
+    bool count(int id) const { return !at(id).empty(); }
+
+    /// The values of \a id, or an empty range
+    Range at(int id) const
+    {
+      long k;
+      if(fDense){
+        k = long(id) - fMinID;
+        if(k < 0 || k + 1 >= long(fOffsets.size())) return Range();
+      }
+      else{
+        auto it = std::lower_bound(fIDs.begin(), fIDs.end(), id);
+        if(it == fIDs.end() || *it != id) return Range();
+        k = it - fIDs.begin();
+      }
+      return Range(fValues.data() + fOffsets[k], fValues.data() + fOffsets[k+1]);
+    }
+
+    /// Number of distinct IDs
+    size_t size() const { return fNIDs; }
+
+    /// \brief Fold the values of each ID into one, in their order
+    ///
+    /// The result has a single value per ID: \a op(...op(op(T(), v0), v1)...)
+    template <class Op>
+    TrackIDMap Combine(Op op) const
+    {
+      TrackIDMap ret;
+      ret.fDense = fDense;
+      ret.fMinID = fMinID;
+      ret.fNIDs = fNIDs;
+      ret.fIDs = fIDs;
+      ret.fOffsets.reserve(fOffsets.size());
+      ret.fValues.reserve(fNIDs);
+      for(size_t k = 0; k + 1 < fOffsets.size(); k++){
+        ret.fOffsets.push_back(ret.fValues.size());
+        if(fOffsets[k] == fOffsets[k+1]) continue;
+        T sum = T();
+        for(unsigned i = fOffsets[k]; i < fOffsets[k+1]; i++) sum = op(sum, fValues[i]);
+        ret.fValues.push_back(sum);
+      }
+      ret.fOffsets.push_back(ret.fValues.size());
+      return ret;
+    }
+
+    /// Heap memory held, in bytes
+    size_t HeapBytes() const
+    {
+      return fIDs.capacity()*sizeof(int) + fOffsets.capacity()*sizeof(unsigned) + fValues.capacity()*sizeof(T);
+    }
+
+  private:
+    bool fDense;
+    int fMinID;                     ///< ID of fOffsets[0] if dense
+    size_t fNIDs;
+    std::vector<int> fIDs;          ///< Sorted IDs, if not dense
+    std::vector<unsigned> fOffsets; ///< Range starts, plus the end
+    std::vector<T> fValues;
+  };
+
+  template <class T> size_t HeapBytes(const TrackIDMap<T>& m) { return m.HeapBytes(); }
+}
+
+#endif
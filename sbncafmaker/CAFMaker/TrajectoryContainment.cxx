@@ -0,0 +1,186 @@
+#include "sbncafmaker/CAFMaker/TrajectoryContainment.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+
+namespace
+{
+  // Trajectory points in structure-of-arrays form, reused between calls
+  struct TrajectoryWorkspace {
+    std::vector<double> x, y, z;
+    std::vector<uint64_t> mask; ///< Bit b set if the point is inside box b
+  };
+
+  // Set bit \a bit of mask[i] for every point i in [begin, end) inside the
+  // box, with the same inclusive bounds as BoxBoundedGeo::ContainsPosition
+  void MarkContained(TrajectoryWorkspace &ws, size_t begin, size_t end,
+                     const geo::BoxBoundedGeo &box, unsigned bit)
+  {
+    const double x0 = box.MinX(), x1 = box.MaxX();
+    const double y0 = box.MinY(), y1 = box.MaxY();
+    const double z0 = box.MinZ(), z1 = box.MaxZ();
+    const double *x = ws.x.data();
+    const double *y = ws.y.data();
+    const double *z = ws.z.data();
+    uint64_t *mask = ws.mask.data();
+    for (size_t i = begin; i < end; i++) {
+      const uint64_t in = (x[i] >= x0) & (x[i] <= x1) & (y[i] >= y0) & (y[i] <= y1) & (z[i] >= z0) & (z[i] <= z1);
+      mask[i] |= in << bit;
+    }
+  }
+
+  int FirstBit(uint64_t bits)
+  {
+    int ret = 0;
+    while (!(bits & 1)) {
+      bits >>= 1;
+      ret++;
+    }
+    return ret;
+  }
+}
+
+namespace caf
+{
+  double ClippedSegmentLength(const double p0[3], const double p1[3],
+                              const double lo[3], const double hi[3])
+  {
+    // Liang-Barsky: the segment is p0 + t*(p1 - p0), t in [0, 1]. Each slab
+    // lo <= x <= hi bounds t to an interval; the part inside the box is
+    // the intersection of the three intervals.
+    double tmin = 0., tmax = 1.;
+    double len2 = 0.;
+    bool outside = false;
+    for (int k = 0; k < 3; k++) {
+      const double d = p1[k] - p0[k];
+      len2 += d*d;
+      if (d == 0.) {
+        // parallel to the slab: either always inside it, or never
+        outside |= (p0[k] < lo[k]) | (p0[k] > hi[k]);
+        continue;
+      }
+      const double inv = 1. / d;
+      const double ta = (lo[k] - p0[k]) * inv;
+      const double tb = (hi[k] - p0[k]) * inv;
+      tmin = std::max(tmin, std::min(ta, tb));
+      tmax = std::min(tmax, std::max(ta, tb));
+    }
+    return outside ? 0. : std::sqrt(len2) * std::max(tmax - tmin, 0.);
+  }
+
+  TrajectoryContainment ComputeTrajectoryContainment(const simb::MCTrajectory &trajectory,
+                                                     const std::vector<geo::BoxBoundedGeo> &active_volumes,
+                                                     const std::vector<std::vector<geo::BoxBoundedGeo>> &tpc_volumes)
+  {
+    TrajectoryContainment ret;
+
+    const size_t npoints = trajectory.size();
+
+    // if no trajectory points, then assume outside AV
+    ret.contained = npoints > 0;
+    ret.cont_tpc = npoints > 0;
+
+    static thread_local TrajectoryWorkspace ws;
+    ws.x.resize(npoints);
+    ws.y.resize(npoints);
+    ws.z.resize(npoints);
+    ws.mask.assign(npoints, 0);
+    for (size_t i = 0; i < npoints; i++) {
+      const TLorentzVector &pos = trajectory.Position(i);
+      ws.x[i] = pos.X();
+      ws.y[i] = pos.Y();
+      ws.z[i] = pos.Z();
+    }
+
+    // Bits [0, nactive) are the active volumes, bits above that the TPCs
+    // of the cryostat the particle enters
+    const unsigned nactive = active_volumes.size();
+    unsigned ntpc_max = 0;
+    for (const std::vector<geo::BoxBoundedGeo> &tpcs: tpc_volumes) ntpc_max = std::max(ntpc_max, (unsigned)tpcs.size());
+    if (nactive + ntpc_max > 64) {
+      std::cout << "CAFMaker: " << nactive << " active and " << ntpc_max
+                << " TPC volumes per cryostat are more than the trajectory containment supports (64)." << std::endl;
+      abort();
+    }
+
+    for (unsigned i = 0; i < nactive; i++) MarkContained(ws, 0, npoints, active_volumes[i], i);
+    const uint64_t active_bits = (nactive == 64) ? ~uint64_t(0) : ((uint64_t(1) << nactive) - 1);
+
+    // Get the entry point
+    for (size_t j = 0; j < npoints; j++) {
+      if (ws.mask[j] & active_bits) {
+        ret.entry_point = j;
+        ret.cryostat_index = FirstBit(ws.mask[j] & active_bits);
+        break;
+      }
+    }
+
+    // if we couldn't find the initial point, set not contained
+    if (ret.entry_point < 0) {
+      ret.contained = false;
+      ret.cont_tpc = false;
+      return ret;
+    }
+
+    // now setup the cryostat the particle is in
+    const std::vector<geo::BoxBoundedGeo> &volumes = tpc_volumes.at(ret.cryostat_index);
+    for (unsigned i = 0; i < volumes.size(); i++) {
+      MarkContained(ws, ret.entry_point, npoints, volumes[i], nactive + i);
+    }
+    const uint64_t tpc_bits = (((uint64_t(1) << volumes.size()) - 1) << nactive);
+    const uint64_t cryo_bit = uint64_t(1) << ret.cryostat_index;
+
+    if (ws.mask[ret.entry_point] & tpc_bits) {
+      ret.tpc_index = FirstBit((ws.mask[ret.entry_point] & tpc_bits) >> nactive);
+      ret.cont_tpc = ret.entry_point == 0;
+    }
+    else {
+      ret.cont_tpc = false;
+    }
+    ret.contained = ret.entry_point == 0;
+
+    const geo::BoxBoundedGeo &active = active_volumes[ret.cryostat_index];
+    const double lo[3] = {active.MinX(), active.MinY(), active.MinZ()};
+    const double hi[3] = {active.MaxX(), active.MaxY(), active.MaxZ()};
+    const uint64_t this_tpc_bit = (ret.tpc_index >= 0) ? (uint64_t(1) << (nactive + ret.tpc_index)) : 0;
+
+    // Get the length and determine if any point leaves the active volume
+    //
+    // Use every trajectory point if possible
+    for (size_t i = ret.entry_point+1; i < npoints; i++) {
+      const uint64_t mask = ws.mask[i];
+      const uint64_t prev_mask = ws.mask[i-1];
+
+      // check if particle has crossed TPC
+      if (ret.tpc_index >= 0 && (mask & tpc_bits & ~this_tpc_bit)) ret.crosses_tpc = true;
+      // check if particle has left tpc
+      if (ret.cont_tpc) ret.cont_tpc = mask & this_tpc_bit;
+      // update if particle is contained
+      if (ret.contained) ret.contained = mask & cryo_bit;
+
+      // update length
+      const double p0[3] = {ws.x[i], ws.y[i], ws.z[i]};
+      const double p1[3] = {ws.x[i-1], ws.y[i-1], ws.z[i-1]};
+      const double dx = p1[0] - p0[0], dy = p1[1] - p0[1], dz = p1[2] - p0[2];
+      const double seglen = std::sqrt(dx*dx + dy*dy + dz*dz);
+      // if points are the same, no length
+      if (seglen >= 1e-6) {
+        // both points contained -- length is total length
+        const float length = ((mask & prev_mask) & cryo_bit) ? seglen : ClippedSegmentLength(p0, p1, lo, hi);
+        ret.length += length;
+      }
+
+      // get the exit point
+      if (!(mask & cryo_bit) && (prev_mask & cryo_bit)) {
+        ret.exit_point = i-1;
+      }
+    }
+    if (ret.exit_point < 0) {
+      ret.exit_point = npoints - 1;
+    }
+
+    return ret;
+  }
+}
@@ -0,0 +1,48 @@
+#ifndef CAF_TRAJECTORYCONTAINMENT_H
+#define CAF_TRAJECTORYCONTAINMENT_H
+
+#include "larcorealg/Geometry/BoxBoundedGeo.h"
+#include "nusimdata/SimulationBase/MCTrajectory.h"
+
+#include <vector>
+
+namespace caf
+{
+  /// Where a true trajectory sits relative to the active and TPC volumes
+  struct TrajectoryContainment {
+    int entry_point = -1;    ///< First point inside an active volume
+    int exit_point = -1;     ///< Last point inside it before leaving (or the last point)
+    int cryostat_index = -1; ///< Active volume containing the entry point
+    int tpc_index = -1;      ///< TPC of that cryostat containing the entry point
+    bool contained = false;  ///< Starts and stays in the active volume
+    bool cont_tpc = false;   ///< Starts and stays in one TPC
+    bool crosses_tpc = false;
+    float length = 0.;       ///< Length contained in the active volume [cm]
+  };
+
+  /// \brief Containment, entry/exit points and contained length of a
+  /// trajectory
+  ///
+  /// The entry point is the first point inside any of \a active_volumes
+  /// (bounds inclusive, as BoxBoundedGeo::ContainsPosition), and the
+  /// particle is then followed in that cryostat and its \a tpc_volumes.
+  /// The exit point is the last point inside before the trajectory leaves
+  /// the cryostat, or the last point if it never does. The length is the
+  /// part of every segment after the entry point that lies inside the
+  /// cryostat, including segments that come back in after leaving it.
+  /// An empty trajectory, or one that never enters, is not contained.
+  ///
+  /// The points are copied once into per-thread x/y/z arrays. The
+  /// containment of each point in each box is computed in one loop per box,
+  /// which the compiler vectorizes, and kept as a bitmask. Segment lengths
+  /// inside the active volume come from a slab clip.
+  TrajectoryContainment ComputeTrajectoryContainment(const simb::MCTrajectory &trajectory,
+                                                     const std::vector<geo::BoxBoundedGeo> &active_volumes,
+                                                     const std::vector<std::vector<geo::BoxBoundedGeo>> &tpc_volumes);
+
+  /// Length of the segment p0-p1 inside the box, by clipping it to each slab
+  double ClippedSegmentLength(const double p0[3], const double p1[3],
+                              const double lo[3], const double hi[3]);
+}
+
+#endif
@@ -0,0 +1,268 @@
+// Checks caf::CaloPointOrder and caf::FindLastWithKey, which pick and
+// order the calorimetry points FillTrackPlaneCalo saves, against the loop
+// they replace: every point tested in turn, its hit found by a linear
+// search keeping the last match, and the saved points sorted by residual
+// range hi->lo.
+//
+// Points with the same residual range may be saved in any order, so the
+// orders are compared as residual ranges, and as the sets of points in
+// each run of equal residual range.
+//
+// Also times both on one track of a few thousand points per plane, with
+// the default cuts and with every point saved.
+
+#include "sbncafmaker/CAFMaker/CaloPointOrder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+  struct Hit {
+    size_t key;
+    unsigned wire;
+  };
+
+  size_t HitKey(const Hit &h) { return h.key; }
+
+  struct Point {
+    unsigned index;
+    float rr;
+    int wire; ///< -1 without a hit
+  };
+
+  // The loop in FillTrackPlaneCalo before the ordering and lookup were split out
+  std::vector<Point> ReferencePoints(const std::vector<float> &rr, const std::vector<size_t> &tps,
+                                     const std::vector<Hit> &hits, float rrstart, float rrend)
+  {
+    std::vector<Point> ret;
+    float rrmax = !rr.empty() ? *std::max_element(rr.begin(), rr.end()) : 0.;
+    for (unsigned i = 0; i < rr.size(); i++) {
+      if ((rrmax - rr[i]) < rrstart || rr[i] < rrend) {
+        Point p{i, rr[i], -1};
+        for (const Hit &h: hits) {
+          if (h.key == tps[i]) p.wire = h.wire;
+        }
+        ret.push_back(p);
+      }
+    }
+    std::sort(ret.begin(), ret.end(), [](const Point &lhs, const Point &rhs) { return lhs.rr > rhs.rr; });
+    return ret;
+  }
+
+  std::vector<Point> Points(const std::vector<float> &rr, const std::vector<size_t> &tps,
+                            const std::vector<Hit> &hits_by_key, float rrstart, float rrend)
+  {
+    std::vector<Point> ret;
+    for (unsigned i: caf::CaloPointOrder(rr, rrstart, rrend)) {
+      const Hit *h = caf::FindLastWithKey(hits_by_key, tps[i], HitKey);
+      ret.push_back({i, rr[i], h ? int(h->wire) : -1});
+    }
+    return ret;
+  }
+
+  // Same points, in the same order up to ties in residual range
+  bool SamePoints(std::vector<Point> a, std::vector<Point> b)
+  {
+    if (a.size() != b.size()) return false;
+    for (size_t k = 0; k < a.size(); k++) {
+      if (a[k].rr != b[k].rr) return false;
+    }
+    auto by_rr_index = [](const Point &lhs, const Point &rhs) {
+      return lhs.rr != rhs.rr ? lhs.rr > rhs.rr : lhs.index < rhs.index;
+    };
+    std::sort(a.begin(), a.end(), by_rr_index);
+    std::sort(b.begin(), b.end(), by_rr_index);
+    for (size_t k = 0; k < a.size(); k++) {
+      if (a[k].index != b[k].index || a[k].wire != b[k].wire) return false;
+    }
+    return true;
+  }
+
+  int nfail = 0;
+
+  void Check(const std::string &what, const std::vector<float> &rr, const std::vector<size_t> &tps,
+             const std::vector<Hit> &hits, float rrstart, float rrend)
+  {
+    std::vector<Hit> hits_by_key = hits;
+    caf::SortByKey(hits_by_key, HitKey);
+
+    const std::vector<Point> ref = ReferencePoints(rr, tps, hits, rrstart, rrend);
+    const std::vector<Point> pts = Points(rr, tps, hits_by_key, rrstart, rrend);
+    if (!SamePoints(ref, pts)) {
+      std::cout << what << ": saved";
+      for (const Point &p: pts) std::cout << " " << p.index << "(" << p.rr << ", " << p.wire << ")";
+      std::cout << ", expected";
+      for (const Point &p: ref) std::cout << " " << p.index << "(" << p.rr << ", " << p.wire << ")";
+      std::cout << std::endl;
+      nfail++;
+    }
+  }
+
+  // One hit per point, with key 100+i
+  std::vector<size_t> Keys(size_t n)
+  {
+    std::vector<size_t> ret;
+    for (size_t i = 0; i < n; i++) ret.push_back(100 + i);
+    return ret;
+  }
+
+  std::vector<Hit> HitsFor(const std::vector<size_t> &tps)
+  {
+    std::vector<Hit> ret;
+    for (size_t i = 0; i < tps.size(); i++) ret.push_back({tps[i], unsigned(i)});
+    return ret;
+  }
+
+  void CheckAllCuts(const std::string &what, const std::vector<float> &rr,
+                    const std::vector<size_t> &tps, const std::vector<Hit> &hits)
+  {
+    Check(what + ", default cuts", rr, tps, hits, 5., 10.);
+    Check(what + ", all points", rr, tps, hits, 1e9, 1e9);
+    Check(what + ", no points", rr, tps, hits, 0., 0.);
+    Check(what + ", start only", rr, tps, hits, 2., 0.);
+    Check(what + ", end only", rr, tps, hits, 0., 2.);
+  }
+
+  void CheckAllCuts(const std::string &what, const std::vector<float> &rr)
+  {
+    const std::vector<size_t> tps = Keys(rr.size());
+    CheckAllCuts(what, rr, tps, HitsFor(tps));
+  }
+
+  void TestOrders()
+  {
+    CheckAllCuts("empty", {});
+    CheckAllCuts("one point", {3.});
+    CheckAllCuts("descending", {6., 5., 4., 3., 2., 1., 0.5});
+    CheckAllCuts("ascending", {0.5, 1., 2., 3., 4., 5., 6.});
+    CheckAllCuts("non-monotonic", {3., 0.5, 6., 2., 5., 1., 4.});
+    CheckAllCuts("descending with a kink", {6., 5., 5.5, 3., 2., 1., 0.5});
+
+    // Ties are both ascending and descending runs
+    CheckAllCuts("all equal", {2., 2., 2., 2.});
+    CheckAllCuts("descending with ties", {6., 5., 5., 3., 1., 1., 0.5});
+    CheckAllCuts("ascending with ties", {0.5, 1., 1., 3., 5., 5., 6.});
+    CheckAllCuts("non-monotonic with ties", {3., 1., 6., 3., 1., 6., 0.5});
+  }
+
+  void TestHitKeys()
+  {
+    const std::vector<float> rr = {6., 5., 4., 3., 2., 1., 0.5};
+    const std::vector<float> rr_up = {0.5, 1., 2., 3., 4., 5., 6.};
+    const std::vector<size_t> tps = Keys(rr.size());
+
+    // Several hits with one key: the last one in the input wins
+    std::vector<Hit> dup = HitsFor(tps);
+    dup.push_back({tps[2], 1000});
+    dup.insert(dup.begin(), {tps[2], 2000});
+    dup.push_back({tps[5], 3000});
+    dup.push_back({tps[5], 3001});
+    CheckAllCuts("duplicate hit keys", rr, tps, dup);
+    CheckAllCuts("duplicate hit keys, ascending", rr_up, tps, dup);
+
+    // Hits in no particular order, some points without a hit, and hits
+    // of no point
+    std::vector<Hit> sparse;
+    for (size_t i = 0; i < tps.size(); i += 2) sparse.push_back({tps[i], unsigned(i)});
+    sparse.push_back({7, 4000});
+    sparse.push_back({100000, 4001});
+    std::reverse(sparse.begin(), sparse.end());
+    CheckAllCuts("missing hits", rr, tps, sparse);
+    CheckAllCuts("no hits", rr, tps, {});
+
+    // Several points sharing a hit
+    const std::vector<size_t> shared = {100, 100, 101, 101, 101, 102, 100};
+    CheckAllCuts("shared hits", rr, shared, dup);
+  }
+
+  // Tracks of random length, with points in either direction or shuffled,
+  // residual ranges rounded so that some are equal, and hit lists with
+  // duplicate and missing keys
+  void TestRandom()
+  {
+    std::mt19937 gen(21);
+    for (int itrk = 0; itrk < 2000; itrk++) {
+      const size_t n = std::uniform_int_distribution<size_t>(0, 60)(gen);
+      const float pitch = std::uniform_real_distribution<float>(0.05, 1.)(gen);
+      std::vector<float> rr;
+      for (size_t i = 0; i < n; i++) rr.push_back(std::round((n - i) * pitch * 4) / 4);
+      switch (itrk % 3) {
+        case 1: std::reverse(rr.begin(), rr.end()); break;
+        case 2: std::shuffle(rr.begin(), rr.end(), gen); break;
+      }
+
+      const std::vector<size_t> tps = Keys(n);
+      std::vector<Hit> hits;
+      std::uniform_int_distribution<size_t> some_key(95, 100 + n + 5);
+      for (size_t i = 0; i < n + 10; i++) hits.push_back({some_key(gen), unsigned(i)});
+
+      Check("random track " + std::to_string(itrk), rr, tps, hits,
+            std::uniform_real_distribution<float>(0., 10.)(gen),
+            std::uniform_real_distribution<float>(0., 10.)(gen));
+    }
+  }
+
+  // One track with npts points on each of 3 planes, and the hits of all
+  // planes in a shuffled key order
+  void Benchmark(unsigned npts, float rrstart, float rrend, const std::string &what)
+  {
+    std::mt19937 gen(1);
+    std::vector<Hit> hits;
+    for (unsigned i = 0; i < 3*npts; i++) hits.push_back({1000 + i, i % 4000});
+    std::shuffle(hits.begin(), hits.end(), gen);
+
+    std::vector<std::vector<float>> rr(3);
+    std::vector<std::vector<size_t>> tps(3);
+    for (unsigned pl = 0; pl < 3; pl++) {
+      for (unsigned i = 0; i < npts; i++) {
+        rr[pl].push_back((pl == 1 ? i : npts - 1 - i) * 0.3f);
+        tps[pl].push_back(1000 + pl*npts + i);
+      }
+    }
+
+    const int reps = npts > 2000 ? 5 : 50;
+    double tref = 0, tnew = 0;
+    size_t nref = 0, nnew = 0;
+    for (int r = 0; r < reps; r++) {
+      const auto t0 = std::chrono::steady_clock::now();
+      for (unsigned pl = 0; pl < 3; pl++) nref += ReferencePoints(rr[pl], tps[pl], hits, rrstart, rrend).size();
+      const auto t1 = std::chrono::steady_clock::now();
+      std::vector<Hit> hits_by_key = hits;
+      caf::SortByKey(hits_by_key, HitKey);
+      for (unsigned pl = 0; pl < 3; pl++) nnew += Points(rr[pl], tps[pl], hits_by_key, rrstart, rrend).size();
+      const auto t2 = std::chrono::steady_clock::now();
+      tref += std::chrono::duration<double, std::micro>(t1 - t0).count();
+      tnew += std::chrono::duration<double, std::micro>(t2 - t1).count();
+    }
+    if (nref != nnew) {
+      std::cout << "Benchmark saved " << nnew/reps << " points, expected " << nref/reps << std::endl;
+      nfail++;
+    }
+    std::cout << npts << " points/plane, " << what << ", " << nnew/reps << " saved: "
+              << tref/reps << " us before, " << tnew/reps << " us now per track" << std::endl;
+  }
+}
+
+int main()
+{
+  TestOrders();
+  TestHitKeys();
+  TestRandom();
+
+  for (unsigned npts: {500u, 2000u, 6000u}) {
+    Benchmark(npts, 5., 25., "default cuts");
+    Benchmark(npts, 1e9, 1e9, "all points");
+  }
+
+  if (nfail > 0) {
+    std::cout << nfail << " checks failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
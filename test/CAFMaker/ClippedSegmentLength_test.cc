@@ -0,0 +1,224 @@
+// Compares caf::ClippedSegmentLength, which FillTrue's ContainedLength
+// sums over the volumes, with the geoalgo-based ContainedLength it
+// replaced, and both with segments whose length is known exactly. Prints
+// the largest difference seen in each set of segments and the time per
+// call of both.
+//
+// Tolerances:
+//  - kTolerance (1e-6 cm) for generic segments: both compute the same
+//    slab intersection, and only differ by rounding.
+//  - kEdgeTolerance (sqrt(1e-5) cm) for segments with an end on, or
+//    within rounding of, a face or edge. The old code decided those cases
+//    with a squared distance tolerance of 1e-5 cm^2, and could count the
+//    full length (or none of it) up to that distance from the box.
+
+#include "sbncafmaker/CAFMaker/TrajectoryContainment.h"
+
+#include "ReferenceContainedLength.h"
+
+#include "larcorealg/GeoAlgo/GeoAlgo.h"
+
+#include "TVector3.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+  const double kTolerance = 1e-6;
+  const double kEdgeTolerance = std::sqrt(1e-5);
+
+  struct Box {
+    double lo[3];
+    double hi[3];
+  };
+
+  // Two boxes in the shape of the ICARUS cryostats [cm]
+  const std::vector<Box> kBoxes = {
+    {{-368.49, -181.86, -894.95}, {-71.94, 134.96, 894.95}},
+    {{  71.94, -181.86, -894.95}, {368.49, 134.96, 894.95}},
+  };
+
+  // What FillTrue's ContainedLength now computes
+  double ClippedContainedLength(const TVector3 &v0, const TVector3 &v1,
+                                const std::vector<Box> &boxes)
+  {
+    const double p0[3] = {v0.X(), v0.Y(), v0.Z()};
+    const double p1[3] = {v1.X(), v1.Y(), v1.Z()};
+    if ((v0 - v1).Mag() < 1e-6) return 0;
+
+    double length = 0;
+    for (const Box &box: boxes) length += caf::ClippedSegmentLength(p0, p1, box.lo, box.hi);
+    return length;
+  }
+
+  struct Segment {
+    TVector3 v0, v1;
+    const char *what;
+  };
+
+  // Compares both on every segment, and prints the largest difference so
+  // that the test log records how close they are
+  int Compare(const std::string &what,
+              const std::vector<Segment> &segments,
+              const std::vector<geoalgo::AABox> &aaboxes,
+              double tolerance)
+  {
+    int nfail = 0;
+    double max_diff = 0;
+    for (const Segment &s: segments) {
+      const double ref = caftest::ReferenceContainedLength(s.v0, s.v1, aaboxes);
+      const double clip = ClippedContainedLength(s.v0, s.v1, kBoxes);
+      max_diff = std::max(max_diff, std::abs(ref - clip));
+      if (std::abs(ref - clip) > tolerance) {
+        if (nfail < 10) {
+          std::cout << "Mismatch (" << s.what << "): ("
+                    << s.v0.X() << ", " << s.v0.Y() << ", " << s.v0.Z() << ") -> ("
+                    << s.v1.X() << ", " << s.v1.Y() << ", " << s.v1.Z() << "): geoalgo "
+                    << ref << " cm, clipped " << clip << " cm" << std::endl;
+        }
+        nfail++;
+      }
+    }
+    std::cout << what << ": " << segments.size() << " segments, " << nfail
+              << " over " << tolerance << " cm, largest difference " << max_diff << " cm" << std::endl;
+    return nfail;
+  }
+
+  // Segments whose contained length is known exactly, checked against both
+  // implementations, so that neither is only checked against the other
+  int CompareExact(const std::vector<geoalgo::AABox> &aaboxes)
+  {
+    const Box &b = kBoxes[0];
+    const double cy = (b.lo[1] + b.hi[1]) / 2;
+    const double cz = (b.lo[2] + b.hi[2]) / 2;
+
+    struct Exact {
+      Segment s;
+      double length;
+    };
+    const std::vector<Exact> exact = {
+      {{{b.lo[0] - 50., cy, cz}, {b.lo[0] + 100., cy, cz}, "entering along x"}, 100.},
+      {{{b.lo[0] - 50., cy, cz}, {b.hi[0] + 50., cy, cz}, "through along x"}, b.hi[0] - b.lo[0]},
+      {{{b.hi[0] + 1., cy, cz}, {kBoxes[1].lo[0] - 1., cy, cz}, "in the gap between the boxes"}, 0.},
+      {{{b.lo[0] + 10., cy, cz}, {kBoxes[1].hi[0] - 10., cy, cz}, "from one box into the other"},
+       (b.hi[0] - b.lo[0] - 10.) + (kBoxes[1].hi[0] - kBoxes[1].lo[0] - 10.)},
+      // 3-4-5 triangle in y-z, half inside
+      {{{b.lo[0] + 1., cy - 30., b.hi[2] - 40.}, {b.lo[0] + 1., cy + 30., b.hi[2] + 40.}, "diagonal through the end face"}, 50.},
+    };
+
+    int nfail = 0;
+    for (const Exact &e: exact) {
+      const double ref = caftest::ReferenceContainedLength(e.s.v0, e.s.v1, aaboxes);
+      const double clip = ClippedContainedLength(e.s.v0, e.s.v1, kBoxes);
+      if (std::abs(ref - e.length) > kTolerance || std::abs(clip - e.length) > kTolerance) {
+        std::cout << "Mismatch (" << e.s.what << "): expected " << e.length << " cm, geoalgo "
+                  << ref << " cm, clipped " << clip << " cm" << std::endl;
+        nfail++;
+      }
+    }
+    std::cout << "exact: " << exact.size() << " segments, " << nfail << " wrong" << std::endl;
+    return nfail;
+  }
+
+  // Degenerate segments, each against the first box
+  std::vector<Segment> DegenerateSegments()
+  {
+    const Box &b = kBoxes[0];
+    const double cx = (b.lo[0] + b.hi[0]) / 2;
+    const double cy = (b.lo[1] + b.hi[1]) / 2;
+    const double cz = (b.lo[2] + b.hi[2]) / 2;
+
+    std::vector<Segment> ret;
+    // zero length, inside and outside
+    ret.push_back({{cx, cy, cz}, {cx, cy, cz}, "zero length inside"});
+    ret.push_back({{0., 500., 0.}, {0., 500., 0.}, "zero length outside"});
+    ret.push_back({{cx, cy, cz}, {cx, cy, cz + 1e-7}, "shorter than 1e-6 cm"});
+    // both ends on a face
+    ret.push_back({{b.lo[0], cy, cz}, {b.lo[0], cy + 50., cz - 100.}, "both ends on one face"});
+    ret.push_back({{b.lo[0], cy, cz}, {b.hi[0], cy + 50., cz - 100.}, "ends on opposite faces"});
+    ret.push_back({{b.lo[0], b.lo[1], cz}, {b.lo[0], b.hi[1], cz}, "along a face, edge to edge"});
+    // parallel to a face
+    ret.push_back({{cx, cy, b.lo[2] - 50.}, {cx, cy, b.hi[2] + 50.}, "parallel to x and y faces, through"});
+    ret.push_back({{cx, b.hi[1] + 1., b.lo[2] - 50.}, {cx, b.hi[1] + 1., b.hi[2] + 50.}, "parallel to a face, outside"});
+    ret.push_back({{cx, cy, cz}, {cx, cy, b.hi[2] + 50.}, "parallel to x and y faces, leaving"});
+    ret.push_back({{b.lo[0] - 10., cy, cz}, {b.hi[0] + 10., cy, cz}, "parallel to y and z faces, through"});
+    // one end exactly on an edge
+    ret.push_back({{b.lo[0], b.lo[1], cz}, {cx, cy, cz}, "edge to inside"});
+    ret.push_back({{b.lo[0], b.lo[1], cz}, {b.lo[0] - 10., b.lo[1] - 10., cz}, "edge to outside, away from the box"});
+    ret.push_back({{b.hi[0], b.hi[1], cz}, {b.lo[0] - 10., b.lo[1] - 10., cz}, "edge through the box to outside"});
+    ret.push_back({{b.lo[0], b.lo[1], b.lo[2]}, {cx, cy, cz}, "corner to inside"});
+    // one end within rounding of a face
+    ret.push_back({{b.lo[0] - 1e-4, cy, cz}, {cx, cy, cz}, "just outside a face to inside"});
+    ret.push_back({{b.lo[0] + 1e-4, cy, cz}, {b.lo[0] - 10., cy, cz}, "just inside a face to outside"});
+    return ret;
+  }
+
+  // Random segments between points in a region around both boxes. With
+  // \a snap, one coordinate of one end is moved onto a face.
+  std::vector<Segment> RandomSegments(std::mt19937 &gen, unsigned n, bool snap)
+  {
+    std::uniform_real_distribution<double> x(-450., 450.);
+    std::uniform_real_distribution<double> y(-250., 200.);
+    std::uniform_real_distribution<double> z(-1000., 1000.);
+    std::uniform_int_distribution<int> pick(0, 5);
+
+    std::vector<Segment> ret;
+    ret.reserve(n);
+    for (unsigned i = 0; i < n; i++) {
+      TVector3 v0(x(gen), y(gen), z(gen));
+      TVector3 v1(x(gen), y(gen), z(gen));
+      if (snap) {
+        const Box &b = kBoxes[i % kBoxes.size()];
+        const int face = pick(gen);
+        const double val = (face < 3) ? b.lo[face] : b.hi[face - 3];
+        v0[face % 3] = val;
+      }
+      ret.push_back({v0, v1, snap ? "random, one end on a face plane" : "random"});
+    }
+    return ret;
+  }
+
+  template <class F>
+  double NanosecondsPerCall(const std::vector<Segment> &segments, F f)
+  {
+    double sum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const Segment &s: segments) sum += f(s);
+    const auto stop = std::chrono::steady_clock::now();
+    // keep the sum alive
+    if (sum < 0) std::cout << sum << std::endl;
+    return std::chrono::duration<double, std::nano>(stop - start).count() / segments.size();
+  }
+}
+
+int main()
+{
+  std::vector<geoalgo::AABox> aaboxes;
+  for (const Box &b: kBoxes) aaboxes.emplace_back(b.lo[0], b.lo[1], b.lo[2], b.hi[0], b.hi[1], b.hi[2]);
+
+  std::mt19937 gen(20221017);
+
+  int nfail = 0;
+  nfail += CompareExact(aaboxes);
+  nfail += Compare("degenerate", DegenerateSegments(), aaboxes, kEdgeTolerance);
+  nfail += Compare("random", RandomSegments(gen, 100000, false), aaboxes, kTolerance);
+  nfail += Compare("random, one end on a face", RandomSegments(gen, 100000, true), aaboxes, kEdgeTolerance);
+
+  const std::vector<Segment> bench = RandomSegments(gen, 1000000, false);
+  const double t_ref = NanosecondsPerCall(bench, [&aaboxes](const Segment &s) { return caftest::ReferenceContainedLength(s.v0, s.v1, aaboxes); });
+  const double t_clip = NanosecondsPerCall(bench, [](const Segment &s) { return ClippedContainedLength(s.v0, s.v1, kBoxes); });
+  std::cout << "ContainedLength over " << kBoxes.size() << " boxes: geoalgo " << t_ref
+            << " ns/call, ClippedSegmentLength " << t_clip << " ns/call" << std::endl;
+
+  if (nfail > 0) {
+    std::cout << nfail << " segments differ" << std::endl;
+    return 1;
+  }
+  return 0;
+}
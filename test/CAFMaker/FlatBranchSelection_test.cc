@@ -0,0 +1,102 @@
+// Checks which flat CAF branch names caf::FlatBranchSelection keeps for a
+// set of include/exclude patterns, and when it reports that it keeps
+// everything.
+//
+// Flat names are the dotted paths of the leaves. The length and index
+// leaves of a vector have a double dot, eg rec.slc..length.
+
+#include "sbncafmaker/CAFMaker/FlatBranchSelection.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+  typedef std::vector<std::string> Patterns;
+
+  int nfail = 0;
+
+  void ExpectInclude(const Patterns &include, const Patterns &exclude,
+                     const std::string &name, bool expect)
+  {
+    const caf::FlatBranchSelection sel(include, exclude);
+    if (sel.Include(name) != expect) {
+      std::cout << name << " is " << (expect ? "dropped" : "kept") << " with include {";
+      for (const std::string &p: include) std::cout << " '" << p << "'";
+      std::cout << " } exclude {";
+      for (const std::string &p: exclude) std::cout << " '" << p << "'";
+      std::cout << " }" << std::endl;
+      nfail++;
+    }
+  }
+
+  void ExpectSelectsAll(const Patterns &include, const Patterns &exclude, bool expect)
+  {
+    const caf::FlatBranchSelection sel(include, exclude);
+    if (sel.SelectsAll() != expect) {
+      std::cout << "SelectsAll() is " << !expect << " with include {";
+      for (const std::string &p: include) std::cout << " '" << p << "'";
+      std::cout << " } and " << exclude.size() << " excludes" << std::endl;
+      nfail++;
+    }
+  }
+}
+
+int main()
+{
+  // A parent selects its children, at any depth, but not its siblings
+  ExpectInclude({"rec.hdr"}, {}, "rec.hdr", true);
+  ExpectInclude({"rec.hdr"}, {}, "rec.hdr.run", true);
+  ExpectInclude({"rec.hdr"}, {}, "rec.hdr.bnbinfo.TOR860", true);
+  ExpectInclude({"rec.hdr"}, {}, "rec.hdrx", false);
+  ExpectInclude({"rec.hdr"}, {}, "rec.hd", false);
+  ExpectInclude({"rec.hdr"}, {}, "rec.mc.nu.E", false);
+  ExpectInclude({"rec.hdr.run"}, {}, "rec.hdr", false);
+
+  // '*' matches across dots
+  ExpectInclude({"rec.slc.*"}, {}, "rec.slc.nu_score", true);
+  ExpectInclude({"rec.slc.*"}, {}, "rec.slc.reco.trk.len", true);
+  ExpectInclude({"rec.slc.*"}, {}, "rec.slc", false);
+  ExpectInclude({"rec.*.len"}, {}, "rec.slc.reco.trk.len", true);
+  ExpectInclude({"*.E"}, {}, "rec.mc.nu.E", true);
+  ExpectInclude({"*.E"}, {}, "rec.mc.nu.Eavail", false);
+  ExpectInclude({"rec.?lc"}, {}, "rec.slc.nu_score", true);
+  ExpectInclude({"*"}, {}, "rec.true_particles.daughters", true);
+
+  // An exclude wins over an include, for the branch and its children
+  ExpectInclude({"*"}, {"rec.true_particles"}, "rec.true_particles.daughters", false);
+  ExpectInclude({"*"}, {"rec.true_particles"}, "rec.hdr.run", true);
+  ExpectInclude({"rec.slc"}, {"rec.slc.reco.trk.calo"}, "rec.slc.reco.trk.calo.points.dedx", false);
+  ExpectInclude({"rec.slc"}, {"rec.slc.reco.trk.calo"}, "rec.slc.reco.trk.len", true);
+  ExpectInclude({"rec.slc.vertex"}, {"rec.slc"}, "rec.slc.vertex.x", false);
+  ExpectInclude({"*"}, {"*"}, "rec.hdr.run", false);
+
+  // The length and index leaves of vectors
+  ExpectInclude({"rec.slc"}, {}, "rec.slc..length", true);
+  ExpectInclude({"rec.slc.*"}, {}, "rec.slc..length", true);
+  ExpectInclude({"rec.slc.reco.trk"}, {}, "rec.slc.reco.trk..idx", true);
+  ExpectInclude({"rec.slc.reco.trk"}, {}, "rec.slc..length", false);
+  ExpectInclude({"rec.sl"}, {}, "rec.slc..length", false);
+  ExpectInclude({"*"}, {"rec.crt_hits"}, "rec.crt_hits..length", false);
+
+  // Nothing is selected without an include
+  ExpectInclude({}, {}, "rec.hdr.run", false);
+
+  // Only a literal '*' include with no excludes selects everything
+  ExpectSelectsAll({"*"}, {}, true);
+  ExpectSelectsAll({"rec.hdr", "*"}, {}, true);
+  ExpectSelectsAll({"*"}, {"rec.true_particles"}, false);
+  ExpectSelectsAll({"rec"}, {}, false);
+  ExpectSelectsAll({"rec.*"}, {}, false);
+  ExpectSelectsAll({"**"}, {}, false);
+  ExpectSelectsAll({"*.*"}, {}, false);
+  ExpectSelectsAll({" *"}, {}, false);
+  ExpectSelectsAll({}, {}, false);
+
+  if (nfail > 0) {
+    std::cout << nfail << " checks failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
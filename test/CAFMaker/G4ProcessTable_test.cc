@@ -0,0 +1,236 @@
+// Checks caf::FindG4Process against the MATCH_PROCESS if-chain that
+// GetG4ProcessID used before the sorted table, for every name that chain
+// knew, and prints the time per lookup of both.
+//
+// The benchmark uses two name distributions: one weighted like the
+// creation and end processes of the particles of a neutrino event (mostly
+// EM processes and transportation), and one uniform over all names.
+
+#include "sbncafmaker/CAFMaker/G4ProcessTable.h"
+
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace
+{
+  // GetG4ProcessID before the sorted table, without the error message
+  caf::g4_process_ ReferenceG4ProcessID(const std::string &process_name) {
+#define MATCH_PROCESS(name) if (process_name == #name) {return caf::kG4 ## name;}
+#define MATCH_PROCESS_NAMED(strname, id) if (process_name == #strname) {return caf::kG4 ## id;}
+    MATCH_PROCESS(primary)
+    MATCH_PROCESS(CoupledTransportation)
+    MATCH_PROCESS(FastScintillation)
+    MATCH_PROCESS(Decay)
+    MATCH_PROCESS(anti_neutronInelastic)
+    MATCH_PROCESS(neutronInelastic)
+    MATCH_PROCESS(anti_protonInelastic)
+    MATCH_PROCESS(protonInelastic)
+    MATCH_PROCESS(hadInelastic)
+    MATCH_PROCESS_NAMED(kaon+Inelastic, kaonpInelastic)
+    MATCH_PROCESS_NAMED(kaon-Inelastic, kaonmInelastic)
+    MATCH_PROCESS_NAMED(kaon+Inelastic, kaonpInelastic)
+    MATCH_PROCESS_NAMED(kaon-Inelastic, kaonmInelastic)
+    MATCH_PROCESS_NAMED(sigma+Inelastic, sigmapInelastic)
+    MATCH_PROCESS_NAMED(sigma-Inelastic, sigmamInelastic)
+    MATCH_PROCESS_NAMED(pi+Inelastic, pipInelastic)
+    MATCH_PROCESS_NAMED(pi-Inelastic, pimInelastic)
+    MATCH_PROCESS_NAMED(xi+Inelastic, xipInelastic)
+    MATCH_PROCESS_NAMED(xi-Inelastic, ximInelastic)
+    MATCH_PROCESS(kaon0LInelastic)
+    MATCH_PROCESS(kaon0SInelastic)
+    MATCH_PROCESS(lambdaInelastic)
+    MATCH_PROCESS_NAMED(anti-lambdaInelastic, anti_lambdaInelastic)
+    MATCH_PROCESS(He3Inelastic)
+    MATCH_PROCESS(ionInelastic)
+    MATCH_PROCESS(xi0Inelastic)
+    MATCH_PROCESS(alphaInelastic)
+    MATCH_PROCESS(tInelastic)
+    MATCH_PROCESS(dInelastic)
+    MATCH_PROCESS(anti_neutronElastic)
+    MATCH_PROCESS(neutronElastic)
+    MATCH_PROCESS(anti_protonElastic)
+    MATCH_PROCESS(protonElastic)
+    MATCH_PROCESS(hadElastic)
+    MATCH_PROCESS_NAMED(kaon+Elastic, kaonpElastic)
+    MATCH_PROCESS_NAMED(kaon-Elastic, kaonmElastic)
+    MATCH_PROCESS_NAMED(pi+Elastic, pipElastic)
+    MATCH_PROCESS_NAMED(pi-Elastic, pimElastic)
+    MATCH_PROCESS(conv)
+    MATCH_PROCESS(phot)
+    MATCH_PROCESS(annihil)
+    MATCH_PROCESS(nCapture)
+    MATCH_PROCESS(nKiller)
+    MATCH_PROCESS(muMinusCaptureAtRest)
+    MATCH_PROCESS(muIoni)
+    MATCH_PROCESS(eBrem)
+    MATCH_PROCESS(CoulombScat)
+    MATCH_PROCESS(hBertiniCaptureAtRest)
+    MATCH_PROCESS(hFritiofCaptureAtRest)
+    MATCH_PROCESS(photonNuclear)
+    MATCH_PROCESS(muonNuclear)
+    MATCH_PROCESS(electronNuclear)
+    MATCH_PROCESS(positronNuclear)
+    MATCH_PROCESS(compt)
+    MATCH_PROCESS(eIoni)
+    MATCH_PROCESS(muBrems)
+    MATCH_PROCESS(hIoni)
+    MATCH_PROCESS(ionIoni)
+    MATCH_PROCESS(hBrems)
+    MATCH_PROCESS(muPairProd)
+    MATCH_PROCESS(hPairProd)
+    MATCH_PROCESS(LArVoxelReadoutScoringProcess)
+    MATCH_PROCESS(Transportation)
+    MATCH_PROCESS(msc)
+    MATCH_PROCESS(StepLimiter)
+    return caf::kG4UNKNOWN;
+#undef MATCH_PROCESS
+#undef MATCH_PROCESS_NAMED
+  }
+
+  // Every name the if-chain matched, in its order
+  const std::vector<std::string> kReferenceNames = {
+    "primary",
+    "CoupledTransportation",
+    "FastScintillation",
+    "Decay",
+    "anti_neutronInelastic",
+    "neutronInelastic",
+    "anti_protonInelastic",
+    "protonInelastic",
+    "hadInelastic",
+    "kaon+Inelastic",
+    "kaon-Inelastic",
+    "sigma+Inelastic",
+    "sigma-Inelastic",
+    "pi+Inelastic",
+    "pi-Inelastic",
+    "xi+Inelastic",
+    "xi-Inelastic",
+    "kaon0LInelastic",
+    "kaon0SInelastic",
+    "lambdaInelastic",
+    "anti-lambdaInelastic",
+    "He3Inelastic",
+    "ionInelastic",
+    "xi0Inelastic",
+    "alphaInelastic",
+    "tInelastic",
+    "dInelastic",
+    "anti_neutronElastic",
+    "neutronElastic",
+    "anti_protonElastic",
+    "protonElastic",
+    "hadElastic",
+    "kaon+Elastic",
+    "kaon-Elastic",
+    "pi+Elastic",
+    "pi-Elastic",
+    "conv",
+    "phot",
+    "annihil",
+    "nCapture",
+    "nKiller",
+    "muMinusCaptureAtRest",
+    "muIoni",
+    "eBrem",
+    "CoulombScat",
+    "hBertiniCaptureAtRest",
+    "hFritiofCaptureAtRest",
+    "photonNuclear",
+    "muonNuclear",
+    "electronNuclear",
+    "positronNuclear",
+    "compt",
+    "eIoni",
+    "muBrems",
+    "hIoni",
+    "ionIoni",
+    "hBrems",
+    "muPairProd",
+    "hPairProd",
+    "LArVoxelReadoutScoringProcess",
+    "Transportation",
+    "msc",
+    "StepLimiter",
+  };
+
+  template <class F>
+  double NanosecondsPerLookup(const std::vector<std::string> &names, F f)
+  {
+    long sum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const std::string &name: names) sum += f(name);
+    const auto stop = std::chrono::steady_clock::now();
+    // keep the sum alive
+    if (sum < 0) std::cout << sum << std::endl;
+    return std::chrono::duration<double, std::nano>(stop - start).count() / names.size();
+  }
+
+  void Benchmark(const std::string &what, const std::vector<std::string> &names)
+  {
+    const double t_ref = NanosecondsPerLookup(names, [](const std::string &n) { return (long)ReferenceG4ProcessID(n); });
+    const double t_table = NanosecondsPerLookup(names, [](const std::string &n) { return (long)caf::FindG4Process(n); });
+    std::cout << what << ": " << names.size() << " lookups: if-chain " << t_ref
+              << " ns/lookup, sorted table " << t_table << " ns/lookup" << std::endl;
+  }
+}
+
+int main()
+{
+  int nfail = 0;
+
+  // Every name of the old chain maps to the same process, and the table
+  // has no name the chain did not know
+  for (const std::string &name: kReferenceNames) {
+    if (caf::FindG4Process(name) != ReferenceG4ProcessID(name) || ReferenceG4ProcessID(name) == caf::kG4UNKNOWN) {
+      std::cout << "Process " << name << " maps to " << caf::FindG4Process(name)
+                << " instead of " << ReferenceG4ProcessID(name) << std::endl;
+      nfail++;
+    }
+  }
+  if (std::size(caf::kG4ProcessNames) != kReferenceNames.size()) {
+    std::cout << std::size(caf::kG4ProcessNames) << " names in the table, "
+              << kReferenceNames.size() << " in the if-chain" << std::endl;
+    nfail++;
+  }
+
+  // Names that are not there, including prefixes and extensions of names
+  // that are, and names before the first and after the last
+  for (const std::string name: {"", "A", "zzz", "eIon", "eIonii", "kaon", "kaon+", "pi+Elasti", "Primary", "primary "}) {
+    if (caf::FindG4Process(name) != caf::kG4UNKNOWN || ReferenceG4ProcessID(name) != caf::kG4UNKNOWN) {
+      std::cout << "Unknown process " << name << " is found" << std::endl;
+      nfail++;
+    }
+  }
+
+  std::mt19937 gen(20221017);
+  const std::vector<std::pair<std::string, double>> weights = {
+    {"eIoni", 20}, {"compt", 18}, {"phot", 12}, {"CoupledTransportation", 10}, {"conv", 6},
+    {"eBrem", 6}, {"neutronInelastic", 6}, {"hIoni", 4}, {"protonInelastic", 3}, {"nCapture", 3},
+    {"annihil", 2}, {"muIoni", 2}, {"hadElastic", 2}, {"Decay", 2}, {"primary", 1},
+    {"pi+Inelastic", 1}, {"pi-Inelastic", 1}, {"muMinusCaptureAtRest", 0.3}, {"electronNuclear", 0.2},
+  };
+  std::vector<double> w;
+  for (const auto &p: weights) w.push_back(p.second);
+  std::discrete_distribution<int> weighted(w.begin(), w.end());
+  std::uniform_int_distribution<int> uniform(0, kReferenceNames.size() - 1);
+
+  std::vector<std::string> event_names, all_names;
+  for (int i = 0; i < 1000000; i++) {
+    event_names.push_back(weights[weighted(gen)].first);
+    all_names.push_back(kReferenceNames[uniform(gen)]);
+  }
+  Benchmark("weighted", event_names);
+  Benchmark("uniform", all_names);
+
+  if (nfail > 0) {
+    std::cout << nfail << " lookups differ" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,273 @@
+// Checks that caf::VerticesNearZ, the z pre-filter of PrepFakeRecoTracks,
+// never drops a vertex that isFromNuVertex would match to a track, with
+// the window equal to the isFromNuVertex distance: tracks exactly at and
+// one rounding step inside the distance, vertices sharing the same z, and
+// random tracks around several vertices.
+//
+// Also times the fake reco track selection on events with many true
+// tracks, scanning every track per vertex as FRFillNumuCC used to, and
+// from the per-vertex lists of PrepFakeRecoTracks.
+
+#include "sbncafmaker/CAFMaker/NuVertexWindow.h"
+
+#include "TVector3.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+  // isFromNuVertex, on the vertex and track start positions
+  bool IsFromVertex(const TVector3 &vtx, const TVector3 &start, float distance = caf::kNuVertexDistance)
+  {
+    return (start - vtx).Mag() < distance;
+  }
+
+  caf::VertexZList SortedZ(const std::vector<TVector3> &vertices)
+  {
+    caf::VertexZList ret;
+    for (unsigned i = 0; i < vertices.size(); i++) ret.push_back({vertices[i].Z(), i});
+    std::sort(ret.begin(), ret.end());
+    return ret;
+  }
+
+  // Vertices each track comes from, with and without the pre-filter
+  std::vector<std::vector<unsigned>> AllPairs(const std::vector<TVector3> &vertices,
+                                              const std::vector<TVector3> &starts)
+  {
+    std::vector<std::vector<unsigned>> ret(vertices.size());
+    for (unsigned i_trk = 0; i_trk < starts.size(); i_trk++) {
+      for (unsigned i = 0; i < vertices.size(); i++) {
+        if (IsFromVertex(vertices[i], starts[i_trk])) ret[i].push_back(i_trk);
+      }
+    }
+    return ret;
+  }
+
+  std::vector<std::vector<unsigned>> Filtered(const std::vector<TVector3> &vertices,
+                                              const std::vector<TVector3> &starts)
+  {
+    std::vector<std::vector<unsigned>> ret(vertices.size());
+    const caf::VertexZList sorted = SortedZ(vertices);
+    for (unsigned i_trk = 0; i_trk < starts.size(); i_trk++) {
+      const auto near = caf::VerticesNearZ(sorted, starts[i_trk].Z(), caf::kNuVertexDistance);
+      for (auto it = near.first; it != near.second; ++it) {
+        if (IsFromVertex(vertices[it->second], starts[i_trk])) ret[it->second].push_back(i_trk);
+      }
+    }
+    return ret;
+  }
+
+  int nfail = 0;
+
+  void Check(const std::string &what, const std::vector<TVector3> &vertices,
+             const std::vector<TVector3> &starts)
+  {
+    const std::vector<std::vector<unsigned>> ref = AllPairs(vertices, starts);
+    const std::vector<std::vector<unsigned>> got = Filtered(vertices, starts);
+    for (unsigned i = 0; i < vertices.size(); i++) {
+      if (ref[i] != got[i]) {
+        std::cout << what << ": vertex " << i << " has " << got[i].size()
+                  << " tracks, expected " << ref[i].size() << std::endl;
+        nfail++;
+      }
+    }
+  }
+
+  void TestEdges()
+  {
+    const double d = caf::kNuVertexDistance;
+    // Vertices at z values that are exact in binary and that are not
+    for (double z0: {0., 100., -347.3, 0.1, 899.99}) {
+      const std::vector<TVector3> vertices = {{0., 0., z0}};
+      std::vector<TVector3> starts;
+      for (double dz: {d, std::nextafter(d, 0.), std::nextafter(d, 10.), d/2, 0.}) {
+        starts.push_back({0., 0., z0 + dz});
+        starts.push_back({0., 0., z0 - dz});
+        // The same z distance with some x, just inside or outside in 3D
+        starts.push_back({1e-3, 0., z0 + dz});
+        starts.push_back({0., -1e-3, z0 - dz});
+      }
+      // Along z, but inside the distance only once x and y are included
+      starts.push_back({3., 3., z0 + 3.});
+      starts.push_back({3., 3., z0 - 2.});
+      Check("vertex at z = " + std::to_string(z0), vertices, starts);
+    }
+
+    // Tracks one rounding step either side of the window, found by
+    // walking z away from the vertex until isFromNuVertex stops matching
+    std::mt19937 gen(23);
+    std::uniform_real_distribution<double> uz(-900., 900.);
+    for (int i = 0; i < 1000; i++) {
+      const double z0 = uz(gen);
+      const std::vector<TVector3> vertices = {{0., 0., z0}};
+      std::vector<TVector3> starts;
+      for (double sign: {-1., 1.}) {
+        double z = z0 + sign*d;
+        while (!IsFromVertex(vertices[0], {0., 0., z})) z = std::nextafter(z, z0);
+        starts.push_back({0., 0., z});
+        starts.push_back({0., 0., std::nextafter(z, z0 + sign*2*d)});
+      }
+      Check("edge " + std::to_string(i), vertices, starts);
+    }
+  }
+
+  // Several vertices with the same z, which sort by index, and a track
+  // near all of them
+  void TestSameZ()
+  {
+    const std::vector<TVector3> vertices = {
+      {0., 0., 50.}, {1., 0., 50.}, {-2., 1., 50.}, {0., 0., 53.}, {0., 3., 50.}, {0., 0., 47.},
+    };
+    std::vector<TVector3> starts;
+    for (double z: {45., 45.5, 47., 50., 52., 55., 57.9, 58.}) {
+      starts.push_back({0., 0., z});
+      starts.push_back({0.5, 1., z});
+    }
+    Check("vertices at the same z", vertices, starts);
+    Check("vertices at the same z, reversed", {vertices.rbegin(), vertices.rend()}, starts);
+  }
+
+  // Tracks scattered around closely spaced vertices, many of them within a
+  // few cm of one or more vertices
+  void TestRandom()
+  {
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<double> uz(-20., 20.), ux(-3., 3.), dv(-6., 6.);
+    for (int ievt = 0; ievt < 200; ievt++) {
+      std::vector<TVector3> vertices;
+      for (int i = 0; i < 1 + ievt % 8; i++) vertices.push_back({ux(gen), ux(gen), uz(gen)});
+      std::vector<TVector3> starts;
+      for (int i = 0; i < 200; i++) {
+        const TVector3 &vtx = vertices[i % vertices.size()];
+        starts.push_back({vtx.X() + dv(gen), vtx.Y() + dv(gen), vtx.Z() + dv(gen)});
+      }
+      Check("random event " + std::to_string(ievt), vertices, starts);
+    }
+  }
+
+  struct TrueTrack {
+    TVector3 start;
+    int pdg;
+    std::string process;
+    double E;
+  };
+
+  // The track selection of FRFillNumuCC before PrepFakeRecoTracks: the
+  // muon with the highest energy, and the pions and protons, each found by
+  // a scan of every track
+  long ScanSelection(const TVector3 &vtx, const std::vector<TrueTrack> &tracks)
+  {
+    int lepton = -1;
+    for (int i = 0; i < int(tracks.size()); i++) {
+      if (IsFromVertex(vtx, tracks[i].start) && std::abs(tracks[i].pdg) == 13 && tracks[i].process == "primary") {
+        if (lepton == -1 || tracks[lepton].E < tracks[i].E) lepton = i;
+      }
+    }
+    long ret = lepton;
+    for (int i = 0; i < int(tracks.size()); i++) {
+      if (IsFromVertex(vtx, tracks[i].start) && (std::abs(tracks[i].pdg) == 211 || std::abs(tracks[i].pdg) == 2212) &&
+          tracks[i].process == "primary" && i != lepton) ret += i;
+    }
+    return ret;
+  }
+
+  // PrepFakeRecoTracks
+  std::vector<std::vector<unsigned>> PrepTracks(const std::vector<TVector3> &vertices,
+                                                const std::vector<TrueTrack> &tracks)
+  {
+    std::vector<std::vector<unsigned>> ret(vertices.size());
+    const caf::VertexZList sorted = SortedZ(vertices);
+    for (unsigned i_trk = 0; i_trk < tracks.size(); i_trk++) {
+      if (tracks[i_trk].process != "primary") continue;
+      const auto near = caf::VerticesNearZ(sorted, tracks[i_trk].start.Z(), caf::kNuVertexDistance);
+      for (auto it = near.first; it != near.second; ++it) {
+        if (IsFromVertex(vertices[it->second], tracks[i_trk].start)) ret[it->second].push_back(i_trk);
+      }
+    }
+    return ret;
+  }
+
+  // The same selection, over the tracks of one vertex
+  long ListSelection(const std::vector<unsigned> &vertex_tracks, const std::vector<TrueTrack> &tracks)
+  {
+    int lepton = -1;
+    for (int i: vertex_tracks) {
+      if (std::abs(tracks[i].pdg) == 13 && (lepton == -1 || tracks[lepton].E < tracks[i].E)) lepton = i;
+    }
+    long ret = lepton;
+    for (int i: vertex_tracks) {
+      if ((std::abs(tracks[i].pdg) == 211 || std::abs(tracks[i].pdg) == 2212) && i != lepton) ret += i;
+    }
+    return ret;
+  }
+
+  // Vertices spread over the ICARUS cryostats. 2% of the tracks are
+  // primaries at one of them, and the rest are secondaries anywhere. Fake
+  // reco runs once per vertex, and again for the slice matched to it.
+  void Benchmark(unsigned nvtx, unsigned ntrk)
+  {
+    std::mt19937 gen(1);
+    std::uniform_real_distribution<double> ux(-350., 350.), uy(-180., 130.), uz(-890., 890.),
+      u01(0., 1.), dv(-1.5, 1.5);
+    const int pdgs[] = {13, 211, 2212, 2112, 22};
+    const char* processes[] = {"eIoni", "compt", "phot", "conv", "hIoni", "muIoni", "neutronInelastic", "Decay"};
+
+    std::vector<TVector3> vertices;
+    for (unsigned i = 0; i < nvtx; i++) vertices.push_back({ux(gen), uy(gen), uz(gen)});
+    std::vector<TrueTrack> tracks;
+    for (unsigned i = 0; i < ntrk; i++) {
+      if (u01(gen) < 0.02) {
+        const TVector3 &vtx = vertices[i % nvtx];
+        tracks.push_back({{vtx.X() + dv(gen), vtx.Y() + dv(gen), vtx.Z() + dv(gen)}, pdgs[i % 5], "primary", 1000.});
+      }
+      else tracks.push_back({{ux(gen), uy(gen), uz(gen)}, 11, processes[i % 8], 10.});
+    }
+
+    const int reps = 20;
+    long scan = 0, list = 0;
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; r++) {
+      for (int pass = 0; pass < 2; pass++) {
+        for (const TVector3 &vtx: vertices) scan += ScanSelection(vtx, tracks);
+      }
+    }
+    const auto t1 = std::chrono::steady_clock::now();
+    for (int r = 0; r < reps; r++) {
+      const std::vector<std::vector<unsigned>> vertex_tracks = PrepTracks(vertices, tracks);
+      for (int pass = 0; pass < 2; pass++) {
+        for (const std::vector<unsigned> &v: vertex_tracks) list += ListSelection(v, tracks);
+      }
+    }
+    const auto t2 = std::chrono::steady_clock::now();
+    if (scan != list) {
+      std::cout << "Benchmark: the per-vertex lists select other tracks than the scan" << std::endl;
+      nfail++;
+    }
+    std::cout << nvtx << " vertices, " << ntrk << " tracks: "
+              << std::chrono::duration<double, std::micro>(t1 - t0).count()/reps << " us scanning, "
+              << std::chrono::duration<double, std::micro>(t2 - t1).count()/reps << " us with PrepFakeRecoTracks" << std::endl;
+  }
+}
+
+int main()
+{
+  TestEdges();
+  TestSameZ();
+  TestRandom();
+
+  for (unsigned nvtx: {1u, 5u, 20u}) {
+    for (unsigned ntrk: {2000u, 20000u}) Benchmark(nvtx, ntrk);
+  }
+
+  if (nfail > 0) {
+    std::cout << nfail << " checks failed" << std::endl;
+    return 1;
+  }
+  return 0;
+}
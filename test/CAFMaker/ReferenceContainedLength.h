@@ -0,0 +1,82 @@
+// ContainedLength from FillTrue.cxx before it used ClippedSegmentLength,
+// kept as the reference the tests check the clipper against. The asserts
+// are left out; results are the same as with NDEBUG.
+
+#ifndef CAF_TEST_REFERENCECONTAINEDLENGTH_H
+#define CAF_TEST_REFERENCECONTAINEDLENGTH_H
+
+#include "larcorealg/GeoAlgo/GeoAlgo.h"
+
+#include "TVector3.h"
+
+#include <vector>
+
+namespace caftest
+{
+  inline double ReferenceContainedLength(const TVector3 &v0, const TVector3 &v1,
+                                         const std::vector<geoalgo::AABox> &boxes)
+  {
+    static const geoalgo::GeoAlgo algo;
+
+    // if points are the same, return 0
+    if ((v0 - v1).Mag() < 1e-6) return 0;
+
+    geoalgo::Point_t p0(v0);
+    geoalgo::Point_t p1(v1);
+    geoalgo::LineSegment line(p0, p1);
+
+    double length = 0;
+    for (auto const &box: boxes) {
+      int n_contained = box.Contain(p0) + box.Contain(p1);
+      if (n_contained == 2) {
+        length = (v1 - v0).Mag();
+        break;
+      }
+      if (n_contained == 1) {
+        auto intersections = algo.Intersection(line, box);
+        if (intersections.size() == 0) {
+          double tol = 1e-5;
+          bool p0_edge = algo.SqDist(p0, box) < tol;
+          bool p1_edge = algo.SqDist(p1, box) < tol;
+          // contained one is on edge -- no length
+          if ((p0_edge && box.Contain(p0)) || (box.Contain(p1) && p1_edge))
+            continue;
+          // un-contained one is on edge -- full length
+          else if ((p0_edge && box.Contain(p1)) || (box.Contain(p0) && p1_edge)) {
+            length = (v1 - v0).Mag();
+            break;
+          }
+        }
+        else if (intersections.size() == 2) {
+          length += (intersections.at(0).ToTLorentzVector().Vect() - intersections.at(1).ToTLorentzVector().Vect()).Mag();
+          continue;
+        }
+        else if (intersections.size() == 1) {
+          TVector3 int_tv(intersections.at(0).ToTLorentzVector().Vect());
+          length += ( box.Contain(p0) ? (v0 - int_tv).Mag() : (v1 - int_tv).Mag() );
+        }
+      }
+      if (n_contained == 0) {
+        auto intersections = algo.Intersection(line, box);
+        if (!(intersections.size() == 0 || intersections.size() == 2)) {
+          double tol = 1e-5;
+          bool p0_edge = algo.SqDist(p0, box) < tol;
+          bool p1_edge = algo.SqDist(p1, box) < tol;
+          // both close to edge -- full length is contained
+          if (p0_edge && p1_edge) {
+            length += (v0 - v1).Mag();
+          }
+        }
+        else if (intersections.size() == 2) {
+          TVector3 start(intersections.at(0).ToTLorentzVector().Vect());
+          TVector3 end(intersections.at(1).ToTLorentzVector().Vect());
+          length += (start - end).Mag();
+        }
+      }
+    }
+
+    return length;
+  }
+}
+
+#endif
@@ -0,0 +1,229 @@
+// Counts the heap allocations and times the end of CAFMaker::produce,
+// where the event-level products and the slices go into the
+// StandardRecord and the record goes into the art product. The old path
+// copied them; the current one moves them. Runs both on the same
+// synthetic high-multiplicity event, and checks that they give records of
+// the same shape.
+//
+// The allocations are counted by replacing the global operator new.
+
+#include "sbnanaobj/StandardRecord/StandardRecord.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace
+{
+  // Allocations made while counting is on
+  bool gCount = false;
+  long gNAlloc = 0;
+  long gNBytes = 0;
+}
+
+void* operator new(std::size_t n)
+{
+  if (gCount) {
+    gNAlloc++;
+    gNBytes += n;
+  }
+  if (void* p = std::malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+void* operator new[](std::size_t n) { return operator new(n); }
+// Not inlined, so that the compiler does not see new/free pairs and warn
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete[](void* p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+namespace
+{
+  // What produce() holds once the slices and truth are filled
+  struct EventProducts {
+    std::vector<caf::SRSlice> slices;
+    caf::SRTruthBranch mc;
+    std::vector<caf::SRFakeReco> fake_reco;
+    std::vector<caf::SRCRTHit> crt_hits;
+    std::vector<caf::SRCRTTrack> crt_tracks;
+    std::vector<caf::SRTrueParticle> true_particles;
+    std::vector<caf::SRBNBInfo> bnbinfo;
+    std::vector<caf::SRNuMIInfo> numiinfo;
+  };
+
+  // A busy ICARUS spill: many cosmic slices, one or two neutrinos, and
+  // the full G4 particle list
+  EventProducts MakeEvent()
+  {
+    EventProducts ret;
+    ret.slices.resize(60);
+    for (caf::SRSlice &slc: ret.slices) {
+      slc.reco.trk.resize(15);
+      slc.reco.shw.resize(8);
+      slc.reco.stub.resize(5);
+    }
+    ret.mc.nu.resize(2);
+    for (caf::SRTrueInteraction &nu: ret.mc.nu) nu.prim.resize(15);
+    ret.fake_reco.resize(2);
+    ret.crt_hits.resize(300);
+    ret.crt_tracks.resize(40);
+    ret.true_particles.resize(8000);
+    ret.bnbinfo.resize(10);
+    ret.numiinfo.resize(10);
+    return ret;
+  }
+
+  // The slice reco objects are duplicated at the top level of the record
+  // in both paths
+  void AddSliceReco(caf::StandardRecord &rec, const caf::SRSlice &slc)
+  {
+    rec.reco.stub.insert(rec.reco.stub.end(), slc.reco.stub.begin(), slc.reco.stub.end());
+    rec.reco.nstub = rec.reco.stub.size();
+    rec.reco.trk.insert(rec.reco.trk.end(), slc.reco.trk.begin(), slc.reco.trk.end());
+    rec.reco.ntrk += slc.reco.trk.size();
+    rec.reco.shw.insert(rec.reco.shw.end(), slc.reco.shw.begin(), slc.reco.shw.end());
+    rec.reco.nshw += slc.reco.shw.size();
+  }
+
+  // produce() before the products were moved
+  void FillByCopy(EventProducts &p, std::vector<caf::StandardRecord> &srcol)
+  {
+    caf::StandardRecord rec;
+    for (caf::SRSlice &recslc: p.slices) {
+      AddSliceReco(rec, recslc);
+      rec.slc.push_back(recslc);
+    }
+    rec.nslc            = rec.slc.size();
+    rec.mc              = p.mc;
+    rec.fake_reco       = p.fake_reco;
+    rec.nfake_reco      = p.fake_reco.size();
+    rec.crt_hits        = p.crt_hits;
+    rec.ncrt_hits       = p.crt_hits.size();
+    rec.crt_tracks      = p.crt_tracks;
+    rec.ncrt_tracks     = p.crt_tracks.size();
+    rec.true_particles  = p.true_particles;
+    rec.ntrue_particles = p.true_particles.size();
+    rec.hdr.nbnbinfo    = p.bnbinfo.size();
+    rec.hdr.bnbinfo     = p.bnbinfo;
+    rec.hdr.nnumiinfo   = p.numiinfo.size();
+    rec.hdr.numiinfo    = p.numiinfo;
+    srcol.push_back(rec);
+  }
+
+  // produce() now
+  void FillByMove(EventProducts &p, std::vector<caf::StandardRecord> &srcol)
+  {
+    caf::StandardRecord rec;
+    for (caf::SRSlice &recslc: p.slices) {
+      AddSliceReco(rec, recslc);
+      rec.slc.push_back(std::move(recslc));
+    }
+    rec.nslc            = rec.slc.size();
+    rec.nfake_reco      = p.fake_reco.size();
+    rec.ncrt_hits       = p.crt_hits.size();
+    rec.ncrt_tracks     = p.crt_tracks.size();
+    rec.ntrue_particles = p.true_particles.size();
+    rec.mc              = std::move(p.mc);
+    rec.fake_reco       = std::move(p.fake_reco);
+    rec.crt_hits        = std::move(p.crt_hits);
+    rec.crt_tracks      = std::move(p.crt_tracks);
+    rec.true_particles  = std::move(p.true_particles);
+    rec.hdr.nbnbinfo    = p.bnbinfo.size();
+    rec.hdr.bnbinfo     = std::move(p.bnbinfo);
+    rec.hdr.nnumiinfo   = p.numiinfo.size();
+    rec.hdr.numiinfo    = std::move(p.numiinfo);
+    srcol.push_back(std::move(rec));
+  }
+
+  struct Result {
+    double ms_per_event;
+    long allocs_per_event;
+    long bytes_per_event;
+    std::vector<caf::StandardRecord> records; ///< The record of the last event
+  };
+
+  template <class F>
+  Result Run(F fill, int nevents)
+  {
+    Result ret{0., 0, 0, {}};
+    double ms = 0;
+    long nalloc = 0, nbytes = 0;
+    for (int i = 0; i < nevents; i++) {
+      EventProducts products = MakeEvent();
+      std::vector<caf::StandardRecord> srcol;
+
+      gNAlloc = gNBytes = 0;
+      gCount = true;
+      const auto start = std::chrono::steady_clock::now();
+      fill(products, srcol);
+      const auto stop = std::chrono::steady_clock::now();
+      gCount = false;
+
+      ms += std::chrono::duration<double, std::milli>(stop - start).count();
+      nalloc += gNAlloc;
+      nbytes += gNBytes;
+      if (i == nevents - 1) ret.records = std::move(srcol);
+    }
+    ret.ms_per_event = ms / nevents;
+    ret.allocs_per_event = nalloc / nevents;
+    ret.bytes_per_event = nbytes / nevents;
+    return ret;
+  }
+
+  // The fields each path fills, compared by size
+  bool SameShape(const caf::StandardRecord &a, const caf::StandardRecord &b)
+  {
+    bool same = a.slc.size() == b.slc.size() && a.nslc == b.nslc &&
+      a.reco.trk.size() == b.reco.trk.size() && a.reco.ntrk == b.reco.ntrk &&
+      a.reco.shw.size() == b.reco.shw.size() && a.reco.nshw == b.reco.nshw &&
+      a.reco.stub.size() == b.reco.stub.size() && a.reco.nstub == b.reco.nstub &&
+      a.mc.nu.size() == b.mc.nu.size() &&
+      a.fake_reco.size() == b.fake_reco.size() && a.nfake_reco == b.nfake_reco &&
+      a.crt_hits.size() == b.crt_hits.size() && a.ncrt_hits == b.ncrt_hits &&
+      a.crt_tracks.size() == b.crt_tracks.size() && a.ncrt_tracks == b.ncrt_tracks &&
+      a.true_particles.size() == b.true_particles.size() && a.ntrue_particles == b.ntrue_particles &&
+      a.hdr.bnbinfo.size() == b.hdr.bnbinfo.size() && a.hdr.nbnbinfo == b.hdr.nbnbinfo &&
+      a.hdr.numiinfo.size() == b.hdr.numiinfo.size() && a.hdr.nnumiinfo == b.hdr.nnumiinfo;
+    for (size_t i = 0; same && i < a.slc.size(); i++) {
+      same = a.slc[i].reco.trk.size() == b.slc[i].reco.trk.size() &&
+        a.slc[i].reco.shw.size() == b.slc[i].reco.shw.size() &&
+        a.slc[i].reco.stub.size() == b.slc[i].reco.stub.size();
+    }
+    for (size_t i = 0; same && i < a.mc.nu.size(); i++) {
+      same = a.mc.nu[i].prim.size() == b.mc.nu[i].prim.size();
+    }
+    return same;
+  }
+
+  void Print(const std::string &what, const Result &r)
+  {
+    std::cout << what << ": " << r.ms_per_event << " ms/event, " << r.allocs_per_event
+              << " allocations/event, " << r.bytes_per_event / 1024 << " kB/event" << std::endl;
+  }
+}
+
+int main()
+{
+  const int nevents = 50;
+  const Result copy = Run(FillByCopy, nevents);
+  const Result move = Run(FillByMove, nevents);
+
+  Print("copy", copy);
+  Print("move", move);
+
+  int nfail = 0;
+  if (copy.records.size() != 1 || move.records.size() != 1 ||
+      !SameShape(copy.records[0], move.records[0])) {
+    std::cout << "The copy and move paths fill different records" << std::endl;
+    nfail++;
+  }
+  // Only the duplication of the slice reco into rec.reco should allocate
+  if (move.allocs_per_event >= copy.allocs_per_event) {
+    std::cout << "Moving allocates as much as copying" << std::endl;
+    nfail++;
+  }
+  return nfail ? 1 : 0;
+}
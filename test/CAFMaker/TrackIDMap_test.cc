@@ -0,0 +1,161 @@
+// Checks caf::TrackIDMap against the std::map<int, std::vector<T>> it
+// replaced in the truth-prep tables, and prints the time both take to be
+// built and probed once per ID.
+//
+// The ID distributions are those of G4 track IDs in an event: compact
+// positive IDs, the same with the negative IDs of shower daughters mixed
+// in, and IDs spread widely enough that the map falls back to binary
+// search.
+
+#include "sbncafmaker/CAFMaker/TrackIDMap.h"
+
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+  typedef std::vector<std::pair<int, int>> Entries;
+
+  // \a nentries values with IDs drawn from \a draw_id, so in no particular
+  // order of ID
+  template <class Draw>
+  Entries MakeEntries(std::mt19937 &gen, unsigned nentries, Draw draw_id)
+  {
+    Entries ret;
+    ret.reserve(nentries);
+    for (unsigned i = 0; i < nentries; i++) ret.push_back({draw_id(gen), int(i)});
+    return ret;
+  }
+
+  std::map<int, std::vector<int>> MakeStdMap(const Entries &entries)
+  {
+    std::map<int, std::vector<int>> ret;
+    for (const std::pair<int, int> &e: entries) ret[e.first].push_back(e.second);
+    return ret;
+  }
+
+  int Check(const std::string &what, const Entries &entries, int probe_lo, int probe_hi)
+  {
+    const caf::TrackIDMap<int> map(entries);
+    const std::map<int, std::vector<int>> ref = MakeStdMap(entries);
+
+    int nfail = 0;
+    if (map.size() != ref.size()) {
+      std::cout << what << ": " << map.size() << " IDs instead of " << ref.size() << std::endl;
+      nfail++;
+    }
+
+    const caf::TrackIDMap<int> sums = map.Combine([](int a, int b) { return a + b; });
+
+    // Every ID in the range, present or not, plus the ends of int
+    std::vector<int> probes = {std::numeric_limits<int>::lowest(), std::numeric_limits<int>::max()};
+    for (int id = probe_lo; id <= probe_hi; id++) probes.push_back(id);
+
+    for (int id: probes) {
+      const auto it = ref.find(id);
+      const std::vector<int> expect = (it == ref.end()) ? std::vector<int>() : it->second;
+      const caf::TrackIDMap<int>::Range got = map.at(id);
+
+      bool same = got.size() == expect.size() && map.count(id) == (it != ref.end());
+      for (size_t i = 0; same && i < expect.size(); i++) same = got[i] == expect[i];
+
+      int sum = 0;
+      for (int v: expect) sum += v;
+      const caf::TrackIDMap<int>::Range got_sum = sums.at(id);
+      same = same && (expect.empty() ? got_sum.empty() : (got_sum.size() == 1 && got_sum[0] == sum));
+
+      if (!same) {
+        if (nfail < 10) std::cout << what << ": values of ID " << id << " differ from std::map" << std::endl;
+        nfail++;
+      }
+    }
+    return nfail;
+  }
+
+  template <class F>
+  double Milliseconds(F f)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    const auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(stop - start).count();
+  }
+
+  // Build, then look up every ID once, as FillTrueG4Particle does
+  void Benchmark(const std::string &what, const Entries &entries, const std::vector<int> &ids)
+  {
+    long sum_map = 0, sum_ref = 0;
+    const double t_map = Milliseconds([&] {
+      const caf::TrackIDMap<int> map(entries);
+      for (int id: ids) for (int v: map.at(id)) sum_map += v;
+    });
+    const double t_ref = Milliseconds([&] {
+      const std::map<int, std::vector<int>> ref = MakeStdMap(entries);
+      for (int id: ids) {
+        if (!ref.count(id)) continue;
+        for (int v: ref.at(id)) sum_ref += v;
+      }
+    });
+    if (sum_map != sum_ref) std::cout << what << ": benchmark sums differ" << std::endl;
+    std::cout << what << ": " << entries.size() << " values, " << ids.size()
+              << " lookups: TrackIDMap " << t_map << " ms, std::map " << t_ref << " ms" << std::endl;
+  }
+}
+
+int main()
+{
+  std::mt19937 gen(20221017);
+
+  // G4 track IDs: 1..N with gaps where particles were not saved
+  std::uniform_int_distribution<int> compact(1, 1000);
+  // Shower daughters show up with negative IDs
+  std::uniform_int_distribution<int> sign(0, 3);
+  auto with_negative = [&compact, &sign](std::mt19937 &g) { return sign(g) ? compact(g) : -compact(g); };
+  // Too spread out for direct indexing
+  std::uniform_int_distribution<int> sparse(-10000000, 10000000);
+
+  int nfail = 0;
+  nfail += Check("empty", Entries(), -5, 5);
+  nfail += Check("one ID", Entries{{7, 1}, {7, 2}, {7, 3}}, 0, 10);
+  nfail += Check("compact", MakeEntries(gen, 20000, compact), -10, 1010);
+  nfail += Check("with negative", MakeEntries(gen, 20000, with_negative), -1010, 1010);
+  nfail += Check("sparse", MakeEntries(gen, 2000, sparse), -10, 10);
+  {
+    // Probe around every ID of the sparse case too
+    const Entries entries = MakeEntries(gen, 2000, sparse);
+    const caf::TrackIDMap<int> map(entries);
+    const std::map<int, std::vector<int>> ref = MakeStdMap(entries);
+    for (const auto &e: entries) {
+      for (int id = e.first - 1; id <= e.first + 1; id++) {
+        if (map.at(id).size() != (ref.count(id) ? ref.at(id).size() : 0)) {
+          if (nfail < 10) std::cout << "sparse: values of ID " << id << " differ from std::map" << std::endl;
+          nfail++;
+        }
+      }
+    }
+  }
+
+  // 10^6 values (IDEs or hits) over 10^5 track IDs
+  std::uniform_int_distribution<int> event_ids(1, 100000);
+  const Entries big = MakeEntries(gen, 1000000, event_ids);
+  std::vector<int> probe_ids;
+  for (int id = 1; id <= 100000; id++) probe_ids.push_back(id);
+  Benchmark("compact", big, probe_ids);
+
+  std::uniform_int_distribution<int> spread(-100000000, 100000000);
+  const Entries big_sparse = MakeEntries(gen, 1000000, spread);
+  std::vector<int> sparse_probes;
+  for (size_t i = 0; i < big_sparse.size(); i += 10) sparse_probes.push_back(big_sparse[i].first);
+  Benchmark("sparse", big_sparse, sparse_probes);
+
+  if (nfail > 0) {
+    std::cout << nfail << " lookups differ" << std::endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,350 @@
+// Compares caf::ComputeTrajectoryContainment with the per-point
+// ContainsPosition/ContainedLength loop FillTrueG4Particle ran before it,
+// and prints the time per trajectory of both.
+//
+// The entry and exit points, cryostat and TPC index, contained, cont_tpc
+// and crosses_tpc have to be identical. The length may differ by:
+//  - kRelTolerance (1e-5) of the length: both sum per-segment lengths in
+//    float, and the clipped and geoalgo segment lengths only differ by
+//    rounding.
+//  - kEdgeTolerance (sqrt(1e-5) cm) for each point on a face of the
+//    active volume, as in ClippedSegmentLength_test.
+
+#include "sbncafmaker/CAFMaker/TrajectoryContainment.h"
+
+#include "ReferenceContainedLength.h"
+
+#include "larcorealg/Geometry/BoxBoundedGeo.h"
+#include "larcorealg/GeoAlgo/GeoAlgo.h"
+#include "nusimdata/SimulationBase/MCTrajectory.h"
+
+#include "TLorentzVector.h"
+#include "TVector3.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+  const double kRelTolerance = 1e-5;
+  const double kEdgeTolerance = std::sqrt(1e-5);
+
+  // The ICARUS cryostats [cm], each split into two TPCs at the cathode
+  const double kCathodeX[2] = {-220.215, 220.215};
+
+  std::vector<geo::BoxBoundedGeo> ActiveVolumes()
+  {
+    return {geo::BoxBoundedGeo(-368.49, -71.94, -181.86, 134.96, -894.95, 894.95),
+            geo::BoxBoundedGeo(  71.94, 368.49, -181.86, 134.96, -894.95, 894.95)};
+  }
+
+  std::vector<std::vector<geo::BoxBoundedGeo>> TPCVolumes()
+  {
+    std::vector<std::vector<geo::BoxBoundedGeo>> ret;
+    for (const geo::BoxBoundedGeo &a: ActiveVolumes()) {
+      const double c = (a.MinX() < 0) ? kCathodeX[0] : kCathodeX[1];
+      ret.push_back({geo::BoxBoundedGeo(a.MinX(), c, a.MinY(), a.MaxY(), a.MinZ(), a.MaxZ()),
+                     geo::BoxBoundedGeo(c, a.MaxX(), a.MinY(), a.MaxY(), a.MinZ(), a.MaxZ())});
+    }
+    return ret;
+  }
+
+  // The loop of FillTrueG4Particle before ComputeTrajectoryContainment,
+  // with the srparticle fields and the particle accessors replaced by the
+  // trajectory
+  caf::TrajectoryContainment ReferenceContainment(const simb::MCTrajectory &trajectory,
+                                                  const std::vector<geo::BoxBoundedGeo> &active_volumes,
+                                                  const std::vector<std::vector<geo::BoxBoundedGeo>> &tpc_volumes)
+  {
+    caf::TrajectoryContainment ret;
+    const unsigned npoints = trajectory.size();
+
+    // if no trajectory points, then assume outside AV
+    ret.cont_tpc = npoints > 0;
+    ret.contained = npoints > 0;
+
+    // Get the entry and exit points
+    int entry_point = -1;
+
+    int cryostat_index = -1;
+    int tpc_index = -1;
+
+    for (unsigned j = 0; j < npoints; j++) {
+      for (unsigned i = 0; i < active_volumes.size(); i++) {
+        if (active_volumes.at(i).ContainsPosition(trajectory.Position(j).Vect())) {
+          entry_point = j;
+          cryostat_index = i;
+          break;
+        }
+      }
+      if (entry_point != -1) break;
+    }
+
+    int exit_point = -1;
+
+    // now setup the cryostat the particle is in
+    std::vector<geo::BoxBoundedGeo> volumes;
+    if (entry_point >= 0) {
+      volumes = tpc_volumes.at(cryostat_index);
+      for (unsigned i = 0; i < volumes.size(); i++) {
+        if (volumes[i].ContainsPosition(trajectory.Position(entry_point).Vect())) {
+          tpc_index = i;
+          ret.cont_tpc = entry_point == 0;
+          break;
+        }
+      }
+      ret.contained = entry_point == 0;
+    }
+    // if we couldn't find the initial point, set not contained
+    else {
+      ret.contained = false;
+    }
+    if (tpc_index < 0) {
+      ret.cont_tpc = false;
+    }
+
+    // setup aa volumes too for length calc
+    std::vector<geoalgo::AABox> aa_volumes;
+    if (entry_point >= 0) {
+      const geo::BoxBoundedGeo &v = active_volumes.at(cryostat_index);
+      aa_volumes.emplace_back(v.MinX(), v.MinY(), v.MinZ(), v.MaxX(), v.MaxY(), v.MaxZ());
+    }
+
+    if (entry_point >= 0) {
+      TVector3 pos = trajectory.Position(entry_point).Vect();
+      for (unsigned i = entry_point+1; i < npoints; i++) {
+        TVector3 this_point = trajectory.Position(i).Vect();
+        // check if particle has crossed TPC
+        if (!ret.crosses_tpc) {
+          for (unsigned j = 0; j < volumes.size(); j++) {
+            if (volumes[j].ContainsPosition(this_point) && tpc_index >= 0 && j != ((unsigned)tpc_index)) {
+              ret.crosses_tpc = true;
+              break;
+            }
+          }
+        }
+        // check if particle has left tpc
+        if (ret.cont_tpc) {
+          ret.cont_tpc = volumes[tpc_index].ContainsPosition(this_point);
+        }
+
+        if (ret.contained) {
+          ret.contained = active_volumes.at(cryostat_index).ContainsPosition(this_point);
+        }
+
+        // update length; the old ContainedLength returned float
+        ret.length += (float)caftest::ReferenceContainedLength(this_point, pos, aa_volumes);
+
+        if (!active_volumes.at(cryostat_index).ContainsPosition(this_point) && active_volumes.at(cryostat_index).ContainsPosition(pos)) {
+          exit_point = i-1;
+        }
+
+        pos = trajectory.Position(i).Vect();
+      }
+    }
+    if (exit_point < 0 && entry_point >= 0) {
+      exit_point = npoints - 1;
+    }
+
+    ret.entry_point = entry_point;
+    ret.exit_point = exit_point;
+    ret.cryostat_index = cryostat_index;
+    ret.tpc_index = tpc_index;
+    return ret;
+  }
+
+  typedef std::vector<TVector3> Points;
+
+  simb::MCTrajectory MakeTrajectory(const Points &points)
+  {
+    simb::MCTrajectory ret;
+    for (const TVector3 &p: points) ret.push_back(TLorentzVector(p, 0.), TLorentzVector(0., 0., 1., 1.));
+    return ret;
+  }
+
+  // Number of points on a face of an active volume
+  unsigned NPointsOnFaces(const Points &points, const std::vector<geo::BoxBoundedGeo> &active_volumes)
+  {
+    unsigned ret = 0;
+    for (const TVector3 &p: points) {
+      for (const geo::BoxBoundedGeo &a: active_volumes) {
+        if (p.X() == a.MinX() || p.X() == a.MaxX() ||
+            p.Y() == a.MinY() || p.Y() == a.MaxY() ||
+            p.Z() == a.MinZ() || p.Z() == a.MaxZ()) ret++;
+      }
+    }
+    return ret;
+  }
+
+  struct Case {
+    Points points;
+    std::string what;
+  };
+
+  int Compare(const std::vector<Case> &cases,
+              const std::vector<geo::BoxBoundedGeo> &active_volumes,
+              const std::vector<std::vector<geo::BoxBoundedGeo>> &tpc_volumes)
+  {
+    int nfail = 0;
+    for (const Case &c: cases) {
+      const simb::MCTrajectory trajectory = MakeTrajectory(c.points);
+      const caf::TrajectoryContainment ref = ReferenceContainment(trajectory, active_volumes, tpc_volumes);
+      const caf::TrajectoryContainment got = caf::ComputeTrajectoryContainment(trajectory, active_volumes, tpc_volumes);
+
+      const double tolerance = kRelTolerance * std::max(1.f, std::abs(ref.length)) +
+        kEdgeTolerance * NPointsOnFaces(c.points, active_volumes);
+
+      const bool same = ref.entry_point == got.entry_point && ref.exit_point == got.exit_point &&
+        ref.cryostat_index == got.cryostat_index && ref.tpc_index == got.tpc_index &&
+        ref.contained == got.contained && ref.cont_tpc == got.cont_tpc && ref.crosses_tpc == got.crosses_tpc &&
+        std::abs(ref.length - got.length) <= tolerance;
+
+      if (!same) {
+        if (nfail < 10) {
+          std::cout << "Mismatch (" << c.what << ", " << c.points.size() << " points):"
+                    << " entry " << ref.entry_point << "/" << got.entry_point
+                    << " exit " << ref.exit_point << "/" << got.exit_point
+                    << " cryostat " << ref.cryostat_index << "/" << got.cryostat_index
+                    << " tpc " << ref.tpc_index << "/" << got.tpc_index
+                    << " contained " << ref.contained << "/" << got.contained
+                    << " cont_tpc " << ref.cont_tpc << "/" << got.cont_tpc
+                    << " crosses_tpc " << ref.crosses_tpc << "/" << got.crosses_tpc
+                    << " length " << ref.length << "/" << got.length << " cm (loop/kernel)" << std::endl;
+        }
+        nfail++;
+      }
+    }
+    return nfail;
+  }
+
+  // Trajectories with no points, one point inside or outside, and the same
+  // point repeated
+  std::vector<Case> ShortCases()
+  {
+    std::vector<Case> ret;
+    ret.push_back({{}, "empty"});
+    ret.push_back({{TVector3(-200., 0., 0.)}, "one point inside"});
+    ret.push_back({{TVector3(0., 0., 0.)}, "one point outside"});
+    ret.push_back({{TVector3(-368.49, 0., 0.)}, "one point on a face"});
+    ret.push_back({{TVector3(-200., 0., 0.), TVector3(-200., 0., 0.)}, "repeated point"});
+    ret.push_back({{TVector3(0., 0., 0.), TVector3(-200., 0., 0.)}, "two points, entering"});
+    return ret;
+  }
+
+  // Straight tracks through both TPCs of a cryostat, from one cryostat to
+  // the other, and leaving one and coming back into it
+  std::vector<Case> CrossingCases()
+  {
+    std::vector<Case> ret;
+    auto line = [](const TVector3 &a, const TVector3 &b, unsigned n) {
+      Points points;
+      for (unsigned i = 0; i <= n; i++) points.push_back(a + (b - a) * (double(i) / n));
+      return points;
+    };
+    ret.push_back({line(TVector3(-300., 0., 0.), TVector3(-100., 10., 50.), 20), "across the cathode"});
+    ret.push_back({line(TVector3(-100., 0., 0.), TVector3(100., 0., 0.), 20), "from one cryostat to the other"});
+    ret.push_back({line(TVector3(-500., 0., 0.), TVector3(500., 0., 0.), 50), "through both cryostats"});
+    ret.push_back({line(TVector3(-300., 0., 0.), TVector3(-300., 0., 1000.), 40), "out of the downstream face"});
+
+    Points reenter = line(TVector3(-300., 0., 800.), TVector3(-300., 0., 1000.), 10);
+    for (const TVector3 &p: line(TVector3(-300., 0., 1000.), TVector3(-150., 0., 0.), 20)) reenter.push_back(p);
+    ret.push_back({reenter, "leaves and comes back"});
+
+    Points zigzag;
+    for (unsigned i = 0; i < 20; i++) zigzag.push_back(TVector3((i % 2) ? -50. : -200., 0., 10.*i));
+    ret.push_back({zigzag, "in and out of the side face"});
+
+    // Points exactly on the faces and on the cathode
+    ret.push_back({{TVector3(-368.49, 0., 0.), TVector3(-300., 0., 0.), TVector3(-220.215, 0., 0.),
+                    TVector3(-100., 0., 0.), TVector3(-71.94, 0., 0.)}, "through face and cathode points"});
+    ret.push_back({{TVector3(-400., 0., 0.), TVector3(-368.49, 0., 0.), TVector3(-400., 10., 0.)}, "touching a face"});
+    ret.push_back({{TVector3(-368.49, -181.86, -894.95), TVector3(-300., 0., 0.)}, "from a corner"});
+    ret.push_back({{TVector3(-368.49, 0., 0.), TVector3(-368.49, 50., 100.), TVector3(-368.49, 50., 200.)}, "along a face"});
+    return ret;
+  }
+
+  // Random walks around both cryostats. With \a snap, some points have a
+  // coordinate moved onto a face of an active or TPC volume.
+  std::vector<Case> RandomCases(std::mt19937 &gen, unsigned n, bool snap,
+                                const std::vector<geo::BoxBoundedGeo> &active_volumes)
+  {
+    std::uniform_real_distribution<double> x(-450., 450.);
+    std::uniform_real_distribution<double> y(-250., 200.);
+    std::uniform_real_distribution<double> z(-1000., 1000.);
+    std::uniform_int_distribution<unsigned> npoints(2, 200);
+    std::normal_distribution<double> step(0., 30.);
+    std::uniform_int_distribution<int> pick(0, 7);
+
+    std::vector<Case> ret;
+    ret.reserve(n);
+    for (unsigned i = 0; i < n; i++) {
+      Points points;
+      TVector3 p(x(gen), y(gen), z(gen));
+      const unsigned np = npoints(gen);
+      for (unsigned j = 0; j < np; j++) {
+        TVector3 q = p;
+        if (snap && pick(gen) == 0) {
+          // onto a face of the active volume, or the cathode
+          const geo::BoxBoundedGeo &a = active_volumes[j % active_volumes.size()];
+          switch (pick(gen) % 4) {
+          case 0: q.SetX((a.MinX() < 0) ? kCathodeX[0] : kCathodeX[1]); break;
+          case 1: q.SetX(pick(gen) % 2 ? a.MinX() : a.MaxX()); break;
+          case 2: q.SetY(pick(gen) % 2 ? a.MinY() : a.MaxY()); break;
+          case 3: q.SetZ(pick(gen) % 2 ? a.MinZ() : a.MaxZ()); break;
+          }
+        }
+        points.push_back(q);
+        p += TVector3(step(gen), step(gen), step(gen));
+      }
+      ret.push_back({points, snap ? "random, points on faces" : "random"});
+    }
+    return ret;
+  }
+
+  template <class F>
+  double NanosecondsPerTrajectory(const std::vector<simb::MCTrajectory> &trajectories, F f)
+  {
+    double sum = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (const simb::MCTrajectory &t: trajectories) sum += f(t).length;
+    const auto stop = std::chrono::steady_clock::now();
+    // keep the sum alive
+    if (sum < 0) std::cout << sum << std::endl;
+    return std::chrono::duration<double, std::nano>(stop - start).count() / trajectories.size();
+  }
+}
+
+int main()
+{
+  const std::vector<geo::BoxBoundedGeo> active_volumes = ActiveVolumes();
+  const std::vector<std::vector<geo::BoxBoundedGeo>> tpc_volumes = TPCVolumes();
+
+  std::mt19937 gen(20221017);
+
+  int nfail = 0;
+  nfail += Compare(ShortCases(), active_volumes, tpc_volumes);
+  nfail += Compare(CrossingCases(), active_volumes, tpc_volumes);
+  nfail += Compare(RandomCases(gen, 20000, false, active_volumes), active_volumes, tpc_volumes);
+  nfail += Compare(RandomCases(gen, 20000, true, active_volumes), active_volumes, tpc_volumes);
+
+  std::vector<simb::MCTrajectory> bench;
+  for (const Case &c: RandomCases(gen, 20000, false, active_volumes)) bench.push_back(MakeTrajectory(c.points));
+  const double t_ref = NanosecondsPerTrajectory(bench, [&](const simb::MCTrajectory &t) {
+    return ReferenceContainment(t, active_volumes, tpc_volumes);
+  });
+  const double t_kernel = NanosecondsPerTrajectory(bench, [&](const simb::MCTrajectory &t) {
+    return caf::ComputeTrajectoryContainment(t, active_volumes, tpc_volumes);
+  });
+  std::cout << "Trajectory containment: per-point loop " << t_ref
+            << " ns/trajectory, ComputeTrajectoryContainment " << t_kernel << " ns/trajectory" << std::endl;
+
+  if (nfail > 0) {
+    std::cout << nfail << " trajectories differ" << std::endl;
+    return 1;
+  }
+  return 0;
+}